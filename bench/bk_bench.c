@@ -0,0 +1,965 @@
+/*
+Copyright (c) 2017, prpl Foundation
+Permission to use, copy, modify, and/or distribute this software for any purpose with or without
+fee is hereby granted, provided that the above copyright notice and this permission notice appear
+in all copies.
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE
+INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE
+FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION,
+ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+/* Broadkey benchmark.
+
+   Measures the latency distribution and throughput of every Broadkey entry
+   point on simulated SRAM PUF data (see iid_sram_sim.h) and prints the
+   results as one JSON document on stdout. It also stress-tests concurrent
+   readers, including a bk_stop while they run, and checks that every crypto
+   backend produces the key codes of the portable one. It exits with a
+   failure status when either check fails.
+
+   Usage: bk_bench [iterations] [bit_error_rate_ppm] [max_threads]
+
+   Build, for example:
+     cc -O2 -I.. bk_bench.c ../iid_sram_sim.c ../iidbroadkey_provision.c \
+        -lbroadkey -lpthread -o bk_bench
+*/
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_HAS_TSC 1
+#else
+#define BENCH_HAS_TSC 0
+#endif
+
+#include "iidbroadkey.h"
+#include "iidreturn_codes.h"
+#include "iid_sram_sim.h"
+#include "iidbroadkey_provision.h"
+
+/************************************************************************
+*                        D E F I N I T I O N S                          *
+*************************************************************************/
+#define BENCH_DEFAULT_ITERATIONS       1000
+#define BENCH_DEFAULT_BER_PPM          50000
+#define BENCH_DEVICE_SEED              UINT64_C(0x6272706C70756621)
+#define BENCH_MAX_KEY_LENGTH           1024
+#define BENCH_MAX_THREADS              64
+#define BENCH_THREAD_OPS               10000
+#define BENCH_PROVISION_DEVICES        256
+#define BENCH_BUNDLE_KEYS              64
+#define BENCH_STRESS_KEY_LENGTH        32
+#define BENCH_STRESS_STOP_DELAY_NS     20000000
+
+typedef struct bench_key_type {
+    key_type_t   key_type;
+    const char * name;
+    uint16_t     size;
+} bench_key_type_t;
+
+typedef struct bench_backend {
+    bk_crypto_backend_t backend;
+    const char        * name;
+} bench_backend_t;
+
+typedef struct bench_sample {
+    uint64_t ns;
+    uint64_t cycles;
+} bench_sample_t;
+
+typedef struct bench_thread {
+    pthread_t  thread;
+    uint32_t   ops;
+    bool       unwrap;
+} bench_thread_t;
+
+typedef struct bench_stress_thread {
+    pthread_t  thread;
+    uint32_t   seed;
+    bool       until_stopped;
+    uint32_t   limit;
+    uint32_t   ops;
+    uint32_t   rejected;
+    uint32_t   failures;
+} bench_stress_thread_t;
+
+static const bench_key_type_t bench_key_types[] = {
+    { S_128,       "S_128",       16 },
+    { S_192,       "S_192",       24 },
+    { S_256,       "S_256",       32 },
+    { E_SECP192R1, "E_SECP192R1", 24 },
+    { E_SECP224R1, "E_SECP224R1", 28 },
+    { E_SECP256R1, "E_SECP256R1", 32 },
+    { E_SECP384R1, "E_SECP384R1", 48 },
+    { E_SECP521R1, "E_SECP521R1", 66 }
+};
+
+static const uint16_t bench_key_lengths[] = { 4, 8, 16, 32, 64, 128, 256, 512, 1024 };
+
+static const uint32_t bench_error_rates_ppm[] = { 0, 10000, 50000, 100000, 150000 };
+
+static const bench_backend_t bench_backends[] = {
+    { BK_CRYPTO_BACKEND_AESNI,    "AESNI"    },
+    { BK_CRYPTO_BACKEND_VAES,     "VAES"     },
+    { BK_CRYPTO_BACKEND_ARMV8_CE, "ARMV8_CE" }
+};
+
+static uint32_t sram_puf[BK_SRAM_SIZE_BYTES / WORD_BYTE];
+static uint32_t activation_code[BK_AC_SIZE_BYTES / WORD_BYTE];
+static uint32_t bench_enroll_code[BK_AC_SIZE_BYTES / WORD_BYTE];
+static uint32_t bench_key[BENCH_MAX_KEY_LENGTH / WORD_BYTE];
+static uint32_t bench_key_code[(BK_KEY_CODE_HEADER_SIZE_BYTES + BENCH_MAX_KEY_LENGTH) / WORD_BYTE];
+static uint32_t bench_out[BENCH_MAX_KEY_LENGTH / WORD_BYTE];
+static uint32_t bench_reference[(BK_KEY_CODE_HEADER_SIZE_BYTES + BENCH_MAX_KEY_LENGTH) / WORD_BYTE];
+static uint8_t  bench_fragments[BENCH_MAX_KEY_LENGTH + 8];
+static uint32_t bench_backend_codes[sizeof(bench_key_lengths) / sizeof(bench_key_lengths[0])]
+                                   [(BK_KEY_CODE_HEADER_SIZE_BYTES + BENCH_MAX_KEY_LENGTH) / WORD_BYTE];
+static uint32_t bench_stress_keys[256][BK_KEY_SIZE_BYTES(S_256) / WORD_BYTE];
+static uint32_t bench_stress_key_code[(BK_KEY_CODE_HEADER_SIZE_BYTES + BENCH_STRESS_KEY_LENGTH) / WORD_BYTE];
+static int      bench_stress_stopping;
+
+static iid_sram_sim_config_t bench_device;
+static bench_sample_t      * bench_samples;
+static bench_sample_t      * bench_stop_samples;
+static uint32_t              bench_iterations;
+static bool                  bench_first_result = true;
+
+
+/****************************************************************************
+*                     P R I V A T E  F U N C T I O N S                      *
+*****************************************************************************/
+static uint64_t bench_now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ((uint64_t)ts.tv_sec * UINT64_C(1000000000)) + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t bench_cycles(void)
+{
+#if BENCH_HAS_TSC == 1
+    return (uint64_t)__rdtsc();
+#else
+    return 0;
+#endif
+}
+
+static void bench_fail(const char * const what, const iid_return_t rc)
+{
+    fprintf(stderr, "bk_bench: %s failed with return code 0x%02X\n", what, (unsigned)rc);
+    exit(EXIT_FAILURE);
+}
+
+static void bench_check(const char * const what, const iid_return_t rc)
+{
+    if (rc != IID_SUCCESS)
+    {
+        bench_fail(what, rc);
+    }
+}
+
+static void bench_power_up(const uint32_t power_up)
+{
+    bench_check("iid_sram_sim_power_up",
+                iid_sram_sim_power_up(&bench_device, power_up, (uint8_t *)sram_puf, sizeof(sram_puf)));
+}
+
+static int bench_compare(const void * const a, const void * const b)
+{
+    const uint64_t x = ((const bench_sample_t *)a)->ns;
+    const uint64_t y = ((const bench_sample_t *)b)->ns;
+
+    return (x > y) - (x < y);
+}
+
+static void bench_begin(bench_sample_t * const sample)
+{
+    sample->cycles = bench_cycles();
+    sample->ns     = bench_now_ns();
+}
+
+static void bench_end(bench_sample_t * const sample)
+{
+    sample->ns     = bench_now_ns() - sample->ns;
+    sample->cycles = bench_cycles() - sample->cycles;
+}
+
+/* Prints one result object. bytes is the payload size per operation, 0 if
+   cycles/byte does not apply. failures is the number of sampled calls that
+   did not return IID_SUCCESS. */
+static void bench_report(      bench_sample_t * const samples,
+                         const char           * const name,
+                         const char           * const variant,
+                         const uint32_t               bytes,
+                         const uint32_t               failures)
+{
+    uint64_t total_ns     = 0;
+    uint64_t total_cycles = 0;
+    uint32_t i;
+
+    for (i = 0; i < bench_iterations; i++)
+    {
+        total_ns     += samples[i].ns;
+        total_cycles += samples[i].cycles;
+    }
+
+    qsort(samples, bench_iterations, sizeof(samples[0]), bench_compare);
+
+    printf("%s    {\"name\": \"%s\", \"variant\": \"%s\", \"iterations\": %u, "
+           "\"p50_ns\": %llu, \"p99_ns\": %llu, \"max_ns\": %llu, \"ops_per_sec\": %.1f",
+           bench_first_result ? "" : ",\n", name, variant, (unsigned)bench_iterations,
+           (unsigned long long)samples[bench_iterations / 2].ns,
+           (unsigned long long)samples[((uint64_t)bench_iterations * 99) / 100].ns,
+           (unsigned long long)samples[bench_iterations - 1].ns,
+           (total_ns == 0) ? 0.0 : ((double)bench_iterations * 1e9) / (double)total_ns);
+
+    if (bytes != 0)
+    {
+        if (BENCH_HAS_TSC == 1)
+        {
+            printf(", \"cycles_per_byte\": %.2f",
+                   (double)total_cycles / ((double)bench_iterations * (double)bytes));
+        }
+        else
+        {
+            printf(", \"cycles_per_byte\": null");
+        }
+        printf(", \"ns_per_byte\": %.3f", (double)total_ns / ((double)bench_iterations * (double)bytes));
+    }
+
+    if (failures != 0)
+    {
+        printf(", \"failures\": %u", (unsigned)failures);
+    }
+
+    printf("}");
+    bench_first_result = false;
+}
+
+static void bench_lifecycle(void)
+{
+    uint32_t i;
+
+    for (i = 0; i < bench_iterations; i++)
+    {
+        bench_power_up(i);
+        bench_begin(&bench_samples[i]);
+        bench_check("bk_init", bk_init((uint8_t *)sram_puf, sizeof(sram_puf)));
+        bench_end(&bench_samples[i]);
+        bench_check("bk_stop", bk_stop());
+    }
+    bench_report(bench_samples, "bk_init", "", 0, 0);
+
+    for (i = 0; i < bench_iterations; i++)
+    {
+        bench_power_up(i);
+        bench_check("bk_init", bk_init((uint8_t *)sram_puf, sizeof(sram_puf)));
+        bench_begin(&bench_samples[i]);
+        bench_check("bk_enroll", bk_enroll((uint8_t *)bench_enroll_code));
+        bench_end(&bench_samples[i]);
+        bench_check("bk_stop", bk_stop());
+    }
+    bench_report(bench_samples, "bk_enroll", "", 0, 0);
+
+    for (i = 0; i < bench_iterations; i++)
+    {
+        bench_power_up(i + 1);
+        bench_check("bk_init", bk_init((uint8_t *)sram_puf, sizeof(sram_puf)));
+        bench_begin(&bench_samples[i]);
+        bench_check("bk_start", bk_start((const uint8_t *)activation_code));
+        bench_end(&bench_samples[i]);
+        bench_begin(&bench_stop_samples[i]);
+        bench_check("bk_stop", bk_stop());
+        bench_end(&bench_stop_samples[i]);
+    }
+    bench_report(bench_samples, "bk_start", "", 0, 0);
+    bench_report(bench_stop_samples, "bk_stop", "", 0, 0);
+}
+
+/* bk_start latency as a function of the bit error rate of the simulated
+   SRAM, which drives the amount of helper-data decoding work. Every rate
+   starts from the activation code enrolled once in main. */
+static void bench_start_error_rates(void)
+{
+    const uint32_t nominal_ppm = bench_device.bit_error_rate_ppm;
+    char           variant[16];
+    uint32_t       failures;
+    uint32_t       r;
+    uint32_t       i;
+
+    for (r = 0; r < (sizeof(bench_error_rates_ppm) / sizeof(bench_error_rates_ppm[0])); r++)
+    {
+        bench_device.bit_error_rate_ppm = bench_error_rates_ppm[r];
+        snprintf(variant, sizeof(variant), "ber_ppm=%u", (unsigned)bench_error_rates_ppm[r]);
+
+        failures = 0;
+        for (i = 0; i < bench_iterations; i++)
+        {
+            bench_power_up(i + 1);
+            bench_check("bk_init", bk_init((uint8_t *)sram_puf, sizeof(sram_puf)));
+            bench_begin(&bench_samples[i]);
+            if (bk_start((const uint8_t *)activation_code) != IID_SUCCESS)
+            {
+                failures++;
+            }
+            bench_end(&bench_samples[i]);
+            bench_check("bk_stop", bk_stop());
+        }
+        bench_report(bench_samples, "bk_start", variant, 0, failures);
+    }
+
+    bench_device.bit_error_rate_ppm = nominal_ppm;
+}
+
+static void bench_derive(void)
+{
+    uint32_t t;
+    uint32_t i;
+
+    for (t = 0; t < (sizeof(bench_key_types) / sizeof(bench_key_types[0])); t++)
+    {
+        for (i = 0; i < bench_iterations; i++)
+        {
+            bench_begin(&bench_samples[i]);
+            bench_check("bk_get_key", bk_get_key(bench_key_types[t].key_type, (uint8_t)i, (uint8_t *)bench_out));
+            bench_end(&bench_samples[i]);
+        }
+        bench_report(bench_samples, "bk_get_key", bench_key_types[t].name, bench_key_types[t].size, 0);
+    }
+}
+
+static void bench_wrap_unwrap(void)
+{
+    char     variant[16];
+    uint16_t key_length;
+    uint8_t  index;
+    uint32_t l;
+    uint32_t i;
+
+    for (i = 0; i < (sizeof(bench_key) / sizeof(bench_key[0])); i++)
+    {
+        bench_key[i] = i * UINT32_C(0x9E3779B9);
+    }
+
+    for (l = 0; l < (sizeof(bench_key_lengths) / sizeof(bench_key_lengths[0])); l++)
+    {
+        snprintf(variant, sizeof(variant), "%u", (unsigned)bench_key_lengths[l]);
+
+        for (i = 0; i < bench_iterations; i++)
+        {
+            bench_begin(&bench_samples[i]);
+            bench_check("bk_wrap", bk_wrap((uint8_t)i, (const uint8_t *)bench_key, bench_key_lengths[l],
+                                           (uint8_t *)bench_key_code));
+            bench_end(&bench_samples[i]);
+        }
+        bench_report(bench_samples, "bk_wrap", variant, bench_key_lengths[l], 0);
+
+        for (i = 0; i < bench_iterations; i++)
+        {
+            bench_begin(&bench_samples[i]);
+            bench_check("bk_unwrap", bk_unwrap((const uint8_t *)bench_key_code, (uint8_t *)bench_out,
+                                               &key_length, &index));
+            bench_end(&bench_samples[i]);
+        }
+        bench_report(bench_samples, "bk_unwrap", variant, bench_key_lengths[l], 0);
+    }
+}
+
+/* Key split into three fragments at odd addresses, as a protocol stack would
+   hold it. Every key code is compared with the bk_wrap one of the same key and
+   index, outside the timed region. */
+static void bench_wrapv_unwrapv(void)
+{
+    bk_const_iovec_t key_segments[3];
+    bk_iovec_t       segments[3];
+    char             variant[16];
+    uint32_t         failures;
+    uint16_t         length;
+    uint16_t         offset;
+    uint16_t         key_length;
+    uint8_t          index;
+    bool             match;
+    uint32_t         l;
+    uint32_t         i;
+    uint32_t         k;
+
+    for (l = 0; l < (sizeof(bench_key_lengths) / sizeof(bench_key_lengths[0])); l++)
+    {
+        length = bench_key_lengths[l];
+        snprintf(variant, sizeof(variant), "%u", (unsigned)length);
+
+        segments[0].base   = &bench_fragments[1];
+        segments[0].length = (uint16_t)(length / 3 + 1);
+        segments[1].base   = segments[0].base + segments[0].length + 1;
+        segments[1].length = (uint16_t)(length / 3);
+        segments[2].base   = segments[1].base + segments[1].length + 1;
+        segments[2].length = (uint16_t)(length - segments[0].length - segments[1].length);
+        iid_memcpy(segments[0].base, (const uint8_t *)bench_key, segments[0].length);
+        iid_memcpy(segments[1].base, (const uint8_t *)bench_key + segments[0].length, segments[1].length);
+        iid_memcpy(segments[2].base, (const uint8_t *)bench_key + segments[0].length + segments[1].length,
+                   segments[2].length);
+        for (i = 0; i < 3; i++)
+        {
+            key_segments[i].base   = segments[i].base;
+            key_segments[i].length = segments[i].length;
+        }
+
+        failures = 0;
+        for (i = 0; i < bench_iterations; i++)
+        {
+            bench_begin(&bench_samples[i]);
+            bench_check("bk_wrapv", bk_wrapv((uint8_t)i, key_segments, 3, (uint8_t *)bench_key_code));
+            bench_end(&bench_samples[i]);
+            bench_check("bk_wrap", bk_wrap((uint8_t)i, (const uint8_t *)bench_key, length,
+                                           (uint8_t *)bench_reference));
+            if (iid_memcmp(bench_reference, bench_key_code, BK_KEY_CODE_HEADER_SIZE_BYTES + length) != 0)
+            {
+                failures++;
+            }
+        }
+        bench_report(bench_samples, "bk_wrapv", variant, length, failures);
+
+        /* The fragments are cleared before each call so that a key left over by
+           the previous one cannot hide a wrong result. */
+        failures = 0;
+        for (i = 0; i < bench_iterations; i++)
+        {
+            for (k = 0; k < 3; k++)
+            {
+                iid_memset(segments[k].base, 0, segments[k].length);
+            }
+            bench_begin(&bench_samples[i]);
+            bench_check("bk_unwrapv", bk_unwrapv((const uint8_t *)bench_key_code, segments, 3,
+                                                 &key_length, &index));
+            bench_end(&bench_samples[i]);
+            match  = (key_length == length) && (index == (uint8_t)(bench_iterations - 1));
+            offset = 0;
+            for (k = 0; k < 3; k++)
+            {
+                match   = match && (iid_memcmp(segments[k].base, (const uint8_t *)bench_key + offset,
+                                               segments[k].length) == 0);
+                offset += segments[k].length;
+            }
+            if (!match || (offset != length))
+            {
+                failures++;
+            }
+        }
+        bench_report(bench_samples, "bk_unwrapv", variant, length, failures);
+    }
+}
+
+static void * bench_thread_main(void * const arg)
+{
+    bench_thread_t * const self = (bench_thread_t *)arg;
+    uint32_t               key[BENCH_MAX_KEY_LENGTH / WORD_BYTE];
+    uint16_t               key_length;
+    uint8_t                index;
+    uint32_t               i;
+    iid_return_t           rc;
+
+    for (i = 0; i < self->ops; i++)
+    {
+        if (self->unwrap)
+        {
+            rc = bk_unwrap((const uint8_t *)bench_key_code, (uint8_t *)key, &key_length, &index);
+        }
+        else
+        {
+            rc = bk_get_key(S_256, (uint8_t)i, (uint8_t *)key);
+        }
+
+        if (rc != IID_SUCCESS)
+        {
+            bench_fail(self->unwrap ? "bk_unwrap" : "bk_get_key", rc);
+        }
+    }
+
+    return NULL;
+}
+
+/* Measures aggregate throughput of concurrent readers, see bk_stop. */
+static void bench_scaling(const uint32_t max_threads, const bool unwrap)
+{
+    static bench_thread_t threads[BENCH_MAX_THREADS];
+    uint64_t              start;
+    uint64_t              elapsed;
+    uint32_t              count;
+    uint32_t              i;
+
+    bench_check("bk_wrap", bk_wrap(0, (const uint8_t *)bench_key, 32, (uint8_t *)bench_key_code));
+
+    for (count = 1; count <= max_threads; count *= 2)
+    {
+        start = bench_now_ns();
+        for (i = 0; i < count; i++)
+        {
+            threads[i].ops    = BENCH_THREAD_OPS;
+            threads[i].unwrap = unwrap;
+            if (pthread_create(&threads[i].thread, NULL, bench_thread_main, &threads[i]) != 0)
+            {
+                fprintf(stderr, "bk_bench: pthread_create failed\n");
+                exit(EXIT_FAILURE);
+            }
+        }
+        for (i = 0; i < count; i++)
+        {
+            pthread_join(threads[i].thread, NULL);
+        }
+        elapsed = bench_now_ns() - start;
+
+        printf("%s    {\"name\": \"%s\", \"threads\": %u, \"ops_per_sec\": %.1f}",
+               bench_first_result ? "" : ",\n", unwrap ? "bk_unwrap_scaling" : "bk_get_key_scaling",
+               (unsigned)count,
+               (elapsed == 0) ? 0.0 : ((double)count * BENCH_THREAD_OPS * 1e9) / (double)elapsed);
+        bench_first_result = false;
+    }
+}
+
+
+/* One stress reader: a mix of bk_get_key, bk_unwrap and bk_wrap followed by
+   bk_unwrap, every result checked against the single-threaded reference.
+   With until_stopped the thread runs until bk_stop rejects it; a call may
+   then return IID_NOT_ALLOWED, but must never return anything else or a
+   wrong result. Once bk_stop has been called, any other error is counted
+   and also ends the thread, so that it can be joined. */
+static void * bench_stress_main(void * const arg)
+{
+    bench_stress_thread_t * const self = (bench_stress_thread_t *)arg;
+    uint32_t                      key[BENCH_STRESS_KEY_LENGTH / WORD_BYTE];
+    uint32_t                      key_code[(BK_KEY_CODE_HEADER_SIZE_BYTES + BENCH_STRESS_KEY_LENGTH) / WORD_BYTE];
+    uint32_t                      out[BENCH_STRESS_KEY_LENGTH / WORD_BYTE];
+    uint16_t                      key_length;
+    uint8_t                       index;
+    uint8_t                       n;
+    uint32_t                      i;
+    iid_return_t                  rc;
+
+    for (i = 0; self->until_stopped || (i < self->limit); i++)
+    {
+        n = (uint8_t)(self->seed + i * 7);
+        switch (i % 3)
+        {
+        case 0:
+            rc = bk_get_key(S_256, n, (uint8_t *)key);
+            if ((rc == IID_SUCCESS) && (iid_memcmp(key, bench_stress_keys[n], sizeof(key)) != 0))
+            {
+                self->failures++;
+            }
+            break;
+        case 1:
+            rc = bk_unwrap((const uint8_t *)bench_stress_key_code, (uint8_t *)out, &key_length, &index);
+            if ((rc == IID_SUCCESS) && ((key_length != BENCH_STRESS_KEY_LENGTH) || (index != 0)
+                                        || (iid_memcmp(out, bench_key, BENCH_STRESS_KEY_LENGTH) != 0)))
+            {
+                self->failures++;
+            }
+            break;
+        default:
+            key[0] = self->seed;
+            key[1] = i;
+            rc = bk_wrap(n, (const uint8_t *)key, BENCH_STRESS_KEY_LENGTH, (uint8_t *)key_code);
+            if (rc == IID_SUCCESS)
+            {
+                rc = bk_unwrap((const uint8_t *)key_code, (uint8_t *)out, &key_length, &index);
+                if ((rc == IID_SUCCESS) && ((key_length != BENCH_STRESS_KEY_LENGTH) || (index != n)
+                                            || (iid_memcmp(out, key, BENCH_STRESS_KEY_LENGTH) != 0)))
+                {
+                    self->failures++;
+                }
+            }
+            break;
+        }
+
+        if (rc == IID_NOT_ALLOWED)
+        {
+            self->rejected++;
+            if (self->until_stopped)
+            {
+                break;
+            }
+        }
+        else if (rc != IID_SUCCESS)
+        {
+            self->failures++;
+            if (self->until_stopped && __atomic_load_n(&bench_stress_stopping, __ATOMIC_ACQUIRE))
+            {
+                break;
+            }
+        }
+        self->ops++;
+    }
+
+    return NULL;
+}
+
+static void bench_stress_run(      bench_stress_thread_t * const threads,
+                             const uint32_t                      count,
+                             const bool                          stop)
+{
+    struct timespec delay;
+    uint32_t        i;
+
+    bench_stress_stopping = 0;
+    for (i = 0; i < count; i++)
+    {
+        threads[i].seed          = i * UINT32_C(0x9E3779B9);
+        threads[i].until_stopped = stop;
+        threads[i].limit         = BENCH_THREAD_OPS;
+        threads[i].ops           = 0;
+        threads[i].rejected      = 0;
+        threads[i].failures      = 0;
+        if (pthread_create(&threads[i].thread, NULL, bench_stress_main, &threads[i]) != 0)
+        {
+            fprintf(stderr, "bk_bench: pthread_create failed\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (stop)
+    {
+        delay.tv_sec  = 0;
+        delay.tv_nsec = BENCH_STRESS_STOP_DELAY_NS;
+        nanosleep(&delay, NULL);
+        __atomic_store_n(&bench_stress_stopping, 1, __ATOMIC_RELEASE);
+        bench_check("bk_stop", bk_stop());
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        pthread_join(threads[i].thread, NULL);
+    }
+}
+
+/* Concurrent readers after start, see bk_stop: first with the module
+   started throughout, then with bk_stop called while they run. Leaves the
+   module stopped. Returns the number of failures. */
+static uint32_t bench_stress(const uint32_t max_threads)
+{
+    static bench_stress_thread_t threads[BENCH_MAX_THREADS];
+    uint32_t                     count = (max_threads < 2) ? 2 : max_threads;
+    uint32_t                     ops;
+    uint32_t                     rejected;
+    uint32_t                     failures;
+    uint32_t                     total_failures = 0;
+    uint32_t                     phase;
+    uint32_t                     i;
+
+    if (count > BENCH_MAX_THREADS)
+    {
+        count = BENCH_MAX_THREADS;
+    }
+
+    for (i = 0; i < 256; i++)
+    {
+        bench_check("bk_get_key", bk_get_key(S_256, (uint8_t)i, (uint8_t *)bench_stress_keys[i]));
+    }
+    bench_check("bk_wrap", bk_wrap(0, (const uint8_t *)bench_key, BENCH_STRESS_KEY_LENGTH,
+                                   (uint8_t *)bench_stress_key_code));
+
+    for (phase = 0; phase < 2; phase++)
+    {
+        bench_stress_run(threads, count, phase == 1);
+
+        ops      = 0;
+        rejected = 0;
+        failures = 0;
+        for (i = 0; i < count; i++)
+        {
+            ops      += threads[i].ops;
+            rejected += threads[i].rejected;
+            failures += threads[i].failures;
+            /* Without bk_stop nothing may be rejected. */
+            if (phase == 0)
+            {
+                failures += threads[i].rejected;
+            }
+        }
+
+        printf("%s    {\"name\": \"bk_stress\", \"variant\": \"%s\", \"threads\": %u, "
+               "\"ops\": %u, \"rejected\": %u, \"failures\": %u}",
+               bench_first_result ? "" : ",\n", (phase == 0) ? "started" : "concurrent_stop",
+               (unsigned)count, (unsigned)ops, (unsigned)rejected, (unsigned)failures);
+        bench_first_result = false;
+        total_failures += failures;
+    }
+
+    return total_failures;
+}
+
+
+/* Starts the module on a fresh power-up with the given backend. Returns
+   false when the backend is not supported by the library or the CPU. */
+static bool bench_start_backend(const bk_crypto_backend_t backend)
+{
+    iid_return_t rc;
+
+    bench_power_up(bench_iterations + 2);
+    bench_check("bk_init", bk_init((uint8_t *)sram_puf, sizeof(sram_puf)));
+    rc = bk_set_crypto_backend(backend);
+    if (rc == IID_INVALID_PARAMETERS)
+    {
+        bench_check("bk_stop", bk_stop());
+        return false;
+    }
+    bench_check("bk_set_crypto_backend", rc);
+    bench_check("bk_start", bk_start((const uint8_t *)activation_code));
+
+    return true;
+}
+
+/* Every accelerated backend must produce the key codes of the portable one,
+   byte for byte, and unwrap them. The portable key codes are the reference;
+   the module is left stopped. Returns the number of failures. */
+static uint32_t bench_backend_equivalence(void)
+{
+    uint32_t total_failures = 0;
+    uint32_t failures;
+    uint16_t key_length;
+    uint8_t  index;
+    uint32_t b;
+    uint32_t l;
+
+    if (!bench_start_backend(BK_CRYPTO_BACKEND_PORTABLE))
+    {
+        bench_fail("bk_set_crypto_backend", IID_INVALID_PARAMETERS);
+    }
+    for (l = 0; l < (sizeof(bench_key_lengths) / sizeof(bench_key_lengths[0])); l++)
+    {
+        bench_check("bk_wrap", bk_wrap((uint8_t)l, (const uint8_t *)bench_key, bench_key_lengths[l],
+                                       (uint8_t *)bench_backend_codes[l]));
+    }
+    bench_check("bk_stop", bk_stop());
+
+    for (b = 0; b < (sizeof(bench_backends) / sizeof(bench_backends[0])); b++)
+    {
+        if (!bench_start_backend(bench_backends[b].backend))
+        {
+            printf("%s    {\"name\": \"bk_crypto_backend\", \"variant\": \"%s\", \"supported\": false}",
+                   bench_first_result ? "" : ",\n", bench_backends[b].name);
+            bench_first_result = false;
+            continue;
+        }
+
+        failures = 0;
+        for (l = 0; l < (sizeof(bench_key_lengths) / sizeof(bench_key_lengths[0])); l++)
+        {
+            if ((bk_wrap((uint8_t)l, (const uint8_t *)bench_key, bench_key_lengths[l],
+                         (uint8_t *)bench_key_code) != IID_SUCCESS)
+                || (iid_memcmp(bench_key_code, bench_backend_codes[l],
+                               BK_KEY_CODE_HEADER_SIZE_BYTES + bench_key_lengths[l]) != 0))
+            {
+                failures++;
+            }
+            if ((bk_unwrap((const uint8_t *)bench_backend_codes[l], (uint8_t *)bench_out,
+                           &key_length, &index) != IID_SUCCESS)
+                || (key_length != bench_key_lengths[l]) || (index != (uint8_t)l)
+                || (iid_memcmp(bench_out, bench_key, key_length) != 0))
+            {
+                failures++;
+            }
+        }
+        bench_check("bk_stop", bk_stop());
+
+        printf("%s    {\"name\": \"bk_crypto_backend\", \"variant\": \"%s\", \"supported\": true, "
+               "\"failures\": %u}",
+               bench_first_result ? "" : ",\n", bench_backends[b].name, (unsigned)failures);
+        bench_first_result = false;
+        total_failures += failures;
+    }
+
+    return total_failures;
+}
+
+
+/* Storage size and unwrap throughput of BENCH_BUNDLE_KEYS keys of one length
+   wrapped as one bundle, against the same keys wrapped as key codes. */
+static void bench_bundle(void)
+{
+    static const uint16_t lengths[] = { 16, 32 };
+    static uint32_t       bundle[BK_BUNDLE_SIZE_BYTES(BENCH_BUNDLE_KEYS, BENCH_BUNDLE_KEYS * 32) / WORD_BYTE];
+    bk_bundle_entry_t     entries[BENCH_BUNDLE_KEYS];
+    uint32_t              bundle_size;
+    uint32_t              key_code_bytes;
+    uint64_t              start;
+    uint64_t              bundle_ns;
+    uint64_t              key_code_ns;
+    uint16_t              key_length;
+    uint8_t               index;
+    uint32_t              l;
+    uint32_t              i;
+
+    for (l = 0; l < (sizeof(lengths) / sizeof(lengths[0])); l++)
+    {
+        for (i = 0; i < BENCH_BUNDLE_KEYS; i++)
+        {
+            entries[i].index      = (uint8_t)i;
+            entries[i].key        = (const uint8_t *)bench_key;
+            entries[i].key_length = lengths[l];
+        }
+        bundle_size    = BK_BUNDLE_SIZE_BYTES(BENCH_BUNDLE_KEYS, (uint32_t)BENCH_BUNDLE_KEYS * lengths[l]);
+        key_code_bytes = (uint32_t)BENCH_BUNDLE_KEYS * (BK_KEY_CODE_HEADER_SIZE_BYTES + lengths[l]);
+
+        bench_check("bk_wrap_bundle", bk_wrap_bundle(entries, BENCH_BUNDLE_KEYS, (uint8_t *)bundle, bundle_size));
+        bench_check("bk_wrap", bk_wrap(0, (const uint8_t *)bench_key, lengths[l], (uint8_t *)bench_key_code));
+
+        start = bench_now_ns();
+        for (i = 0; i < bench_iterations; i++)
+        {
+            bench_check("bk_unwrap_bundle_entry",
+                        bk_unwrap_bundle_entry((const uint8_t *)bundle, bundle_size, (uint16_t)(i % BENCH_BUNDLE_KEYS),
+                                               (uint8_t *)bench_out, &key_length, &index));
+        }
+        bundle_ns = bench_now_ns() - start;
+
+        start = bench_now_ns();
+        for (i = 0; i < bench_iterations; i++)
+        {
+            bench_check("bk_unwrap", bk_unwrap((const uint8_t *)bench_key_code, (uint8_t *)bench_out,
+                                               &key_length, &index));
+        }
+        key_code_ns = bench_now_ns() - start;
+
+        printf("%s    {\"name\": \"bk_bundle\", \"variant\": \"%u\", \"keys\": %u, "
+               "\"bundle_bytes\": %u, \"key_code_bytes\": %u, "
+               "\"bundle_unwrap_ops_per_sec\": %.1f, \"key_code_unwrap_ops_per_sec\": %.1f}",
+               bench_first_result ? "" : ",\n", (unsigned)lengths[l], (unsigned)BENCH_BUNDLE_KEYS,
+               (unsigned)bundle_size, (unsigned)key_code_bytes,
+               (bundle_ns == 0) ? 0.0 : ((double)bench_iterations * 1e9) / (double)bundle_ns,
+               (key_code_ns == 0) ? 0.0 : ((double)bench_iterations * 1e9) / (double)key_code_ns);
+        bench_first_result = false;
+    }
+}
+
+/* Throughput of bk_provision_enroll on distinct simulated devices. */
+static void bench_provision(const uint32_t max_threads)
+{
+    bk_provision_item_t * items;
+    uint32_t            * images;
+    uint32_t            * codes;
+    iid_sram_sim_config_t device = bench_device;
+    uint64_t              start;
+    uint64_t              elapsed;
+    uint32_t              count;
+    uint32_t              i;
+
+    items  = (bk_provision_item_t *)calloc(BENCH_PROVISION_DEVICES, sizeof(bk_provision_item_t));
+    images = (uint32_t *)calloc(BENCH_PROVISION_DEVICES, BK_SRAM_SIZE_BYTES);
+    codes  = (uint32_t *)calloc(BENCH_PROVISION_DEVICES, BK_AC_SIZE_BYTES);
+    if ((items == NULL) || (images == NULL) || (codes == NULL))
+    {
+        fprintf(stderr, "bk_bench: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (i = 0; i < BENCH_PROVISION_DEVICES; i++)
+    {
+        device.device_seed = BENCH_DEVICE_SEED + i;
+        items[i].sram_puf        = (uint8_t *)&images[i * (BK_SRAM_SIZE_BYTES / WORD_BYTE)];
+        items[i].sram_puf_size   = BK_SRAM_SIZE_BYTES;
+        items[i].activation_code = (uint8_t *)&codes[i * (BK_AC_SIZE_BYTES / WORD_BYTE)];
+        bench_check("iid_sram_sim_power_up",
+                    iid_sram_sim_power_up(&device, 0, items[i].sram_puf, BK_SRAM_SIZE_BYTES));
+    }
+
+    for (count = 1; count <= max_threads; count *= 2)
+    {
+        start = bench_now_ns();
+        bench_check("bk_provision_enroll", bk_provision_enroll(items, BENCH_PROVISION_DEVICES, (uint16_t)count));
+        elapsed = bench_now_ns() - start;
+
+        printf("%s    {\"name\": \"bk_provision_enroll\", \"threads\": %u, \"devices_per_sec\": %.1f}",
+               bench_first_result ? "" : ",\n", (unsigned)count,
+               (elapsed == 0) ? 0.0 : ((double)BENCH_PROVISION_DEVICES * 1e9) / (double)elapsed);
+        bench_first_result = false;
+    }
+
+    free(items);
+    free(images);
+    free(codes);
+}
+
+
+/****************************************************************************
+*                                 M A I N                                   *
+*****************************************************************************/
+int main(int argc, char * argv[])
+{
+    uint8_t  major_version;
+    uint8_t  minor_version;
+    uint32_t max_threads;
+    uint32_t failures;
+    long     cpus;
+
+    bench_iterations = (argc > 1) ? (uint32_t)strtoul(argv[1], NULL, 0) : BENCH_DEFAULT_ITERATIONS;
+
+    bench_device.device_seed        = BENCH_DEVICE_SEED;
+    bench_device.bias_ppm           = IID_SRAM_SIM_PPM / 2;
+    bench_device.bit_error_rate_ppm = (argc > 2) ? (uint32_t)strtoul(argv[2], NULL, 0) : BENCH_DEFAULT_BER_PPM;
+
+    cpus        = sysconf(_SC_NPROCESSORS_ONLN);
+    max_threads = (argc > 3) ? (uint32_t)strtoul(argv[3], NULL, 0) : ((cpus > 0) ? (uint32_t)cpus : 1);
+    if (max_threads > BENCH_MAX_THREADS)
+    {
+        max_threads = BENCH_MAX_THREADS;
+    }
+
+    if (bench_iterations == 0)
+    {
+        fprintf(stderr, "usage: %s [iterations] [bit_error_rate_ppm] [max_threads]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    bench_samples      = (bench_sample_t *)calloc(bench_iterations, sizeof(bench_sample_t));
+    bench_stop_samples = (bench_sample_t *)calloc(bench_iterations, sizeof(bench_sample_t));
+    if ((bench_samples == NULL) || (bench_stop_samples == NULL))
+    {
+        fprintf(stderr, "bk_bench: out of memory\n");
+        return EXIT_FAILURE;
+    }
+
+    bench_check("bk_get_software_version", bk_get_software_version(&major_version, &minor_version));
+
+    printf("{\n  \"version\": \"%u.%u\",\n  \"bit_error_rate_ppm\": %u,\n  \"results\": [\n",
+           (unsigned)major_version, (unsigned)minor_version, (unsigned)bench_device.bit_error_rate_ppm);
+
+    /* Enroll once on power-up 0; every later power-up is started with this code. */
+    bench_power_up(0);
+    bench_check("bk_init", bk_init((uint8_t *)sram_puf, sizeof(sram_puf)));
+    bench_check("bk_enroll", bk_enroll((uint8_t *)activation_code));
+    bench_check("bk_stop", bk_stop());
+
+    bench_lifecycle();
+
+    bench_power_up(bench_iterations + 1);
+    bench_check("bk_init", bk_init((uint8_t *)sram_puf, sizeof(sram_puf)));
+    bench_check("bk_start", bk_start((const uint8_t *)activation_code));
+
+    bench_derive();
+    bench_wrap_unwrap();
+    bench_wrapv_unwrapv();
+    bench_bundle();
+    bench_scaling(max_threads, false);
+    bench_scaling(max_threads, true);
+    failures = bench_stress(max_threads);
+    failures += bench_backend_equivalence();
+
+    bench_start_error_rates();
+    bench_provision(max_threads);
+
+    printf("\n  ]\n}\n");
+
+    free(bench_samples);
+    free(bench_stop_samples);
+
+    return (failures == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
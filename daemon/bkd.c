@@ -0,0 +1,626 @@
+/*
+Copyright (c) 2017, prpl Foundation
+Permission to use, copy, modify, and/or distribute this software for any purpose with or without
+fee is hereby granted, provided that the above copyright notice and this permission notice appear
+in all copies.
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE
+INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE
+FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION,
+ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+/* Broadkey key service daemon.
+
+   Owns the single started Broadkey instance of the device and serves
+   bk_get_key, bk_wrap and bk_unwrap to local processes over a Unix domain
+   socket, see iidbroadkey_client.h for the protocol. Requests received from
+   all clients in one poll round are processed together through the batch
+   functions of iidbroadkey.h.
+
+   The socket is created with mode 0700: only processes of the user running
+   bkd can connect.
+
+   Usage: bkd -a activation_code_file (-i sram_image_file | -S seed [-b ber_ppm] [-P power_up])
+              [-s socket_path]
+
+   When the activation code file does not exist, bkd enrolls and writes it.
+   -S runs on simulated SRAM (iid_sram_sim.h), for testing without hardware.
+
+   Build, for example:
+     cc -O2 -I.. bkd.c ../iid_sram_sim.c -lbroadkey -o bkd
+*/
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "iidbroadkey.h"
+#include "iidbroadkey_client.h"
+#include "iidreturn_codes.h"
+#include "iid_sram_sim.h"
+
+/************************************************************************
+*                        D E F I N I T I O N S                          *
+*************************************************************************/
+#define BKD_MAX_CLIENTS                256
+#define BKD_BATCH_SIZE                 64
+#define BKD_MAX_PER_CLIENT             8
+
+typedef struct bkd_slot {
+    int          client;
+    uint8_t      op;
+    uint8_t      index;
+    uint16_t     request_length;
+    uint16_t     response_length;
+    iid_return_t status;
+    uint32_t     request[BK_SERVICE_MAX_MESSAGE_BYTES / WORD_BYTE];
+    uint32_t     response[BK_SERVICE_MAX_MESSAGE_BYTES / WORD_BYTE];
+} bkd_slot_t;
+
+static uint32_t              sram_puf[BK_SRAM_SIZE_BYTES / WORD_BYTE];
+static uint32_t              activation_code[BK_AC_SIZE_BYTES / WORD_BYTE];
+static struct pollfd         poll_fds[BKD_MAX_CLIENTS + 1];
+static nfds_t                poll_count;
+static nfds_t                collect_next;
+static bkd_slot_t            slots[BKD_BATCH_SIZE];
+static bk_key_request_t      get_key_requests[BKD_BATCH_SIZE];
+static bk_wrap_request_t     wrap_requests[BKD_BATCH_SIZE];
+static bk_unwrap_request_t   unwrap_requests[BKD_BATCH_SIZE];
+static volatile sig_atomic_t stopping;
+
+
+/****************************************************************************
+*                     P R I V A T E  F U N C T I O N S                      *
+*****************************************************************************/
+static void bkd_on_signal(int signal_number)
+{
+    (void)signal_number;
+    stopping = 1;
+}
+
+static void bkd_wipe(      void   * const buffer,
+                     const size_t         size)
+{
+    volatile uint8_t * p = (volatile uint8_t *)buffer;
+    size_t             i;
+
+    for (i = 0; i < size; i++)
+    {
+        p[i] = 0;
+    }
+}
+
+static bool bkd_valid_key_type(const uint32_t key_type)
+{
+    switch (key_type)
+    {
+        case S_128:
+        case S_192:
+        case S_256:
+        case E_SECP192R1:
+        case E_SECP224R1:
+        case E_SECP256R1:
+        case E_SECP384R1:
+        case E_SECP521R1:
+            return true;
+        default:
+            return false;
+    }
+}
+
+static bool bkd_read_file(const char   * const path,
+                                void     * const buffer,
+                          const size_t           size)
+{
+    FILE * file = fopen(path, "rb");
+    bool   read;
+
+    if (file == NULL)
+    {
+        return false;
+    }
+    read = (fread(buffer, 1, size, file) == size);
+    fclose(file);
+
+    return read;
+}
+
+static bool bkd_write_file(const char   * const path,
+                           const void     * const buffer,
+                           const size_t           size)
+{
+    FILE * file;
+    int    fd;
+    bool   written;
+
+    fd = open(path, O_WRONLY | O_CREAT | O_EXCL, 0600);
+    if (fd < 0)
+    {
+        return false;
+    }
+    file = fdopen(fd, "wb");
+    if (file == NULL)
+    {
+        close(fd);
+        return false;
+    }
+    written = (fwrite(buffer, 1, size, file) == size);
+
+    return (fclose(file) == 0) && written;
+}
+
+static int bkd_listen(const char * const path)
+{
+    struct sockaddr_un address;
+    mode_t             mask;
+    int                fd;
+    int                rc;
+
+    if (strlen(path) >= sizeof(address.sun_path))
+    {
+        return -1;
+    }
+
+    iid_memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    iid_memcpy(address.sun_path, path, strlen(path));
+
+    fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if (fd < 0)
+    {
+        return -1;
+    }
+
+    /* The socket file is created with mode 0700, there is no window in which
+       another user could connect. */
+    (void)unlink(path);
+    mask = umask(0077);
+    rc   = bind(fd, (const struct sockaddr *)&address, sizeof(address));
+    (void)umask(mask);
+    if ((rc != 0) || (listen(fd, SOMAXCONN) != 0))
+    {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+static void bkd_close_client(const nfds_t client)
+{
+    if (poll_fds[client].fd >= 0)
+    {
+        close(poll_fds[client].fd);
+        poll_fds[client].fd = -1;
+    }
+}
+
+/* Checks a request and prepares its slot. Returns false on a malformed
+   packet, after which the client is disconnected. */
+static bool bkd_parse(bkd_slot_t * const slot, const ssize_t received)
+{
+    const uint8_t * const request = (const uint8_t *)slot->request;
+    uint32_t              key_type;
+
+    if (received < BK_SERVICE_HEADER_SIZE_BYTES)
+    {
+        return false;
+    }
+
+    slot->op             = request[0];
+    slot->index          = request[1];
+    slot->request_length = (uint16_t)(request[2] | (request[3] << 8));
+    key_type             = (uint32_t)request[4] | ((uint32_t)request[5] << 8) |
+                           ((uint32_t)request[6] << 16) | ((uint32_t)request[7] << 24);
+
+    if (received != (ssize_t)(BK_SERVICE_HEADER_SIZE_BYTES + (size_t)slot->request_length))
+    {
+        return false;
+    }
+
+    slot->status          = IID_SUCCESS;
+    slot->response_length = 0;
+
+    switch (slot->op)
+    {
+        case BK_SERVICE_GET_KEY:
+            if ((slot->request_length != 0) || !bkd_valid_key_type(key_type))
+            {
+                slot->status = IID_INVALID_PARAMETERS;
+            }
+            else
+            {
+                slot->response_length = (uint16_t)BK_KEY_SIZE_BYTES(key_type);
+            }
+            /* The key type is kept in the response header until processing. */
+            iid_memcpy(&((uint8_t *)slot->response)[4], &key_type, sizeof(key_type));
+            break;
+        case BK_SERVICE_WRAP:
+            if ((slot->request_length < 4) || (slot->request_length > 1024) ||
+                ((slot->request_length % WORD_BYTE) != 0))
+            {
+                slot->status = IID_INVALID_PARAMETERS;
+            }
+            break;
+        case BK_SERVICE_UNWRAP:
+            if ((slot->request_length <= BK_KEY_CODE_HEADER_SIZE_BYTES) ||
+                ((slot->request_length % WORD_BYTE) != 0))
+            {
+                slot->status = IID_INVALID_PARAMETERS;
+            }
+            break;
+        default:
+            slot->status = IID_INVALID_PARAMETERS;
+            break;
+    }
+
+    return true;
+}
+
+static void bkd_process(const uint16_t count)
+{
+    uint16_t get_key_count = 0;
+    uint16_t wrap_count    = 0;
+    uint16_t unwrap_count  = 0;
+    uint32_t key_type;
+    uint16_t i;
+
+    for (i = 0; i < count; i++)
+    {
+        bkd_slot_t * const slot    = &slots[i];
+        uint8_t    * const payload = &((uint8_t *)slot->response)[BK_SERVICE_HEADER_SIZE_BYTES];
+
+        if (slot->status != IID_SUCCESS)
+        {
+            continue;
+        }
+
+        switch (slot->op)
+        {
+            case BK_SERVICE_GET_KEY:
+                iid_memcpy(&key_type, &((uint8_t *)slot->response)[4], sizeof(key_type));
+                get_key_requests[get_key_count].key_type = (key_type_t)key_type;
+                get_key_requests[get_key_count].index    = slot->index;
+                get_key_requests[get_key_count].key      = payload;
+                get_key_count++;
+                break;
+            case BK_SERVICE_WRAP:
+                wrap_requests[wrap_count].index      = slot->index;
+                wrap_requests[wrap_count].key        = &((const uint8_t *)slot->request)[BK_SERVICE_HEADER_SIZE_BYTES];
+                wrap_requests[wrap_count].key_length = slot->request_length;
+                wrap_requests[wrap_count].key_code   = payload;
+                wrap_count++;
+                break;
+            default:
+                unwrap_requests[unwrap_count].key_code = &((const uint8_t *)slot->request)[BK_SERVICE_HEADER_SIZE_BYTES];
+                unwrap_requests[unwrap_count].key      = payload;
+                unwrap_count++;
+                break;
+        }
+    }
+
+    if (get_key_count != 0)
+    {
+        (void)bk_get_key_batch(get_key_requests, get_key_count);
+    }
+    if (wrap_count != 0)
+    {
+        (void)bk_wrap_batch(wrap_requests, wrap_count);
+    }
+    if (unwrap_count != 0)
+    {
+        (void)bk_unwrap_batch(unwrap_requests, unwrap_count);
+    }
+
+    get_key_count = 0;
+    wrap_count    = 0;
+    unwrap_count  = 0;
+
+    for (i = 0; i < count; i++)
+    {
+        bkd_slot_t * const slot = &slots[i];
+
+        if (slot->status != IID_SUCCESS)
+        {
+            continue;
+        }
+
+        switch (slot->op)
+        {
+            case BK_SERVICE_GET_KEY:
+                slot->status = get_key_requests[get_key_count++].status;
+                break;
+            case BK_SERVICE_WRAP:
+                slot->status          = wrap_requests[wrap_count].status;
+                slot->response_length = (uint16_t)(BK_KEY_CODE_HEADER_SIZE_BYTES + slot->request_length);
+                wrap_count++;
+                break;
+            default:
+                slot->status          = unwrap_requests[unwrap_count].status;
+                slot->index           = unwrap_requests[unwrap_count].index;
+                slot->response_length = unwrap_requests[unwrap_count].key_length;
+                unwrap_count++;
+                break;
+        }
+    }
+}
+
+/* Sends the responses in the order the requests were received, so that
+   every connection sees its responses in order. */
+static void bkd_respond(const uint16_t count)
+{
+    uint16_t i;
+
+    for (i = 0; i < count; i++)
+    {
+        bkd_slot_t * const slot     = &slots[i];
+        uint8_t    * const response = (uint8_t *)slot->response;
+        const int          fd       = poll_fds[slot->client].fd;
+        size_t             length;
+
+        if (slot->status != IID_SUCCESS)
+        {
+            slot->response_length = 0;
+        }
+        response[0] = slot->status;
+        response[1] = (slot->op == BK_SERVICE_UNWRAP) ? slot->index : 0;
+        response[2] = (uint8_t)slot->response_length;
+        response[3] = (uint8_t)(slot->response_length >> 8);
+        iid_memset(&response[4], 0, 4);
+        length = BK_SERVICE_HEADER_SIZE_BYTES + (size_t)slot->response_length;
+
+        if ((fd >= 0) && (send(fd, response, length, MSG_NOSIGNAL | MSG_DONTWAIT) != (ssize_t)length))
+        {
+            /* A client that does not read its responses is dropped. */
+            bkd_close_client((nfds_t)slot->client);
+        }
+
+        bkd_wipe(slot->request, BK_SERVICE_HEADER_SIZE_BYTES + (size_t)slot->request_length);
+        bkd_wipe(slot->response, sizeof(slot->response));
+    }
+}
+
+/* Receives up to BKD_MAX_PER_CLIENT requests per readable client. */
+/* Clients are scanned round-robin, starting after the last client a request
+   was taken from in the previous round, so that busy clients early in
+   poll_fds cannot fill every batch and starve the others. */
+static uint16_t bkd_collect(void)
+{
+    const nfds_t clients = poll_count - 1;
+    uint16_t     count   = 0;
+    uint16_t     taken;
+    nfds_t       visited;
+    nfds_t       c;
+    ssize_t      received;
+
+    for (visited = 0; (visited < clients) && (count < BKD_BATCH_SIZE); visited++)
+    {
+        c = 1 + ((collect_next + visited) % clients);
+        if ((poll_fds[c].fd < 0) || (poll_fds[c].revents == 0))
+        {
+            continue;
+        }
+
+        for (taken = 0; (taken < BKD_MAX_PER_CLIENT) && (count < BKD_BATCH_SIZE); taken++)
+        {
+            received = recv(poll_fds[c].fd, slots[count].request, sizeof(slots[count].request), MSG_DONTWAIT);
+            if (received < 0)
+            {
+                if ((errno != EAGAIN) && (errno != EWOULDBLOCK))
+                {
+                    bkd_close_client(c);
+                }
+                break;
+            }
+            if ((received == 0) || !bkd_parse(&slots[count], received))
+            {
+                bkd_close_client(c);
+                break;
+            }
+            slots[count].client = (int)c;
+            count++;
+        }
+    }
+    if (clients != 0)
+    {
+        collect_next = (collect_next + visited) % clients;
+    }
+
+    return count;
+}
+
+static void bkd_accept(const int listen_fd)
+{
+    int fd;
+
+    for (;;)
+    {
+        fd = accept(listen_fd, NULL, NULL);
+        if (fd < 0)
+        {
+            return;
+        }
+        if (poll_count > BKD_MAX_CLIENTS)
+        {
+            close(fd);
+            continue;
+        }
+        (void)fcntl(fd, F_SETFD, FD_CLOEXEC);
+        poll_fds[poll_count].fd      = fd;
+        poll_fds[poll_count].events  = POLLIN;
+        poll_fds[poll_count].revents = 0;
+        poll_count++;
+    }
+}
+
+/* Removes closed clients. Only called when no slot refers to a client. */
+static void bkd_compact(void)
+{
+    nfds_t c;
+    nfds_t kept = 1;
+
+    for (c = 1; c < poll_count; c++)
+    {
+        if (poll_fds[c].fd >= 0)
+        {
+            poll_fds[kept++] = poll_fds[c];
+        }
+    }
+    poll_count = kept;
+}
+
+static int bkd_usage(const char * const name)
+{
+    fprintf(stderr,
+            "usage: %s -a activation_code_file (-i sram_image_file | -S seed [-b ber_ppm] [-P power_up])\n"
+            "          [-s socket_path]\n", name);
+
+    return EXIT_FAILURE;
+}
+
+
+/****************************************************************************
+*                                 M A I N                                   *
+*****************************************************************************/
+int main(int argc, char * argv[])
+{
+    const char          * socket_path = BK_SERVICE_DEFAULT_PATH;
+    const char          * ac_path     = NULL;
+    const char          * image_path  = NULL;
+    iid_sram_sim_config_t device;
+    uint32_t              power_up    = 0;
+    bool                  simulate    = false;
+    bool                  enroll      = false;
+    struct sigaction      action;
+    iid_return_t          rc;
+    uint16_t              count;
+    int                   listen_fd;
+    int                   option;
+
+    device.device_seed        = 0;
+    device.bias_ppm           = IID_SRAM_SIM_PPM / 2;
+    device.bit_error_rate_ppm = 50000;
+
+    while ((option = getopt(argc, argv, "a:i:S:b:P:s:")) != -1)
+    {
+        switch (option)
+        {
+            case 'a': ac_path                   = optarg;                           break;
+            case 'i': image_path                = optarg;                           break;
+            case 'S': device.device_seed        = strtoull(optarg, NULL, 0);
+                      simulate                  = true;                             break;
+            case 'b': device.bit_error_rate_ppm = (uint32_t)strtoul(optarg, NULL, 0); break;
+            case 'P': power_up                  = (uint32_t)strtoul(optarg, NULL, 0); break;
+            case 's': socket_path               = optarg;                           break;
+            default:  return bkd_usage(argv[0]);
+        }
+    }
+
+    if ((ac_path == NULL) || ((image_path == NULL) == !simulate))
+    {
+        return bkd_usage(argv[0]);
+    }
+
+    if (simulate)
+    {
+        rc = iid_sram_sim_power_up(&device, power_up, (uint8_t *)sram_puf, sizeof(sram_puf));
+    }
+    else
+    {
+        rc = bkd_read_file(image_path, sram_puf, sizeof(sram_puf)) ? IID_SUCCESS : IID_INVALID_PARAMETERS;
+    }
+
+    if (rc == IID_SUCCESS)
+    {
+        rc = bk_init((uint8_t *)sram_puf, sizeof(sram_puf));
+    }
+
+    if (rc == IID_SUCCESS)
+    {
+        enroll = !bkd_read_file(ac_path, activation_code, sizeof(activation_code));
+        if (enroll)
+        {
+            rc = bk_enroll((uint8_t *)activation_code);
+        }
+        else
+        {
+            rc = bk_start((const uint8_t *)activation_code);
+        }
+    }
+
+    /* bk_init only records the image, it is read by bk_enroll or bk_start. */
+    bkd_wipe(sram_puf, sizeof(sram_puf));
+
+    if ((rc == IID_SUCCESS) && enroll && !bkd_write_file(ac_path, activation_code, sizeof(activation_code)))
+    {
+        fprintf(stderr, "bkd: cannot write %s\n", ac_path);
+        (void)bk_stop();
+        return EXIT_FAILURE;
+    }
+
+    if (rc != IID_SUCCESS)
+    {
+        fprintf(stderr, "bkd: cannot start Broadkey, return code 0x%02X\n", (unsigned)rc);
+        (void)bk_stop();
+        return EXIT_FAILURE;
+    }
+
+    listen_fd = bkd_listen(socket_path);
+    if (listen_fd < 0)
+    {
+        fprintf(stderr, "bkd: cannot listen on %s\n", socket_path);
+        (void)bk_stop();
+        return EXIT_FAILURE;
+    }
+
+    iid_memset(&action, 0, sizeof(action));
+    action.sa_handler = bkd_on_signal;
+    sigemptyset(&action.sa_mask);
+    (void)sigaction(SIGINT, &action, NULL);
+    (void)sigaction(SIGTERM, &action, NULL);
+
+    poll_fds[0].fd     = listen_fd;
+    poll_fds[0].events = POLLIN;
+    poll_count         = 1;
+
+    while (!stopping)
+    {
+        if (poll(poll_fds, poll_count, -1) < 0)
+        {
+            continue;
+        }
+
+        if (poll_fds[0].revents != 0)
+        {
+            bkd_accept(listen_fd);
+        }
+
+        count = bkd_collect();
+        if (count != 0)
+        {
+            bkd_process(count);
+            bkd_respond(count);
+        }
+
+        bkd_compact();
+    }
+
+    bkd_compact();
+    while (poll_count > 1)
+    {
+        bkd_close_client(--poll_count);
+    }
+    close(listen_fd);
+    (void)unlink(socket_path);
+    (void)bk_stop();
+
+    return EXIT_SUCCESS;
+}
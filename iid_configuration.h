@@ -57,6 +57,15 @@ extern "C"
  */
 #define IID_HAS_LONG_LONG 1
 
+/******************************************************************************
+ * Broadkey engines
+ *****************************************************************************/
+
+/*! \brief Build trace points.
+    \details Macro IID_BK_TRACE can be set to 1 to build the USDT probes and the trace callback of the Broadkey functions, see iidbroadkey_trace.h. When it is 0 the probes expand to nothing.
+ */
+#define IID_BK_TRACE 1
+
 /*@}*/
 
 #ifdef __cplusplus
@@ -0,0 +1,126 @@
+/*
+Copyright (c) 2017, prpl Foundation
+Permission to use, copy, modify, and/or distribute this software for any purpose with or without
+fee is hereby granted, provided that the above copyright notice and this permission notice appear
+in all copies.
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE
+INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE
+FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION,
+ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+#include "iid_sram_sim.h"
+#include "iidreturn_codes.h"
+
+/************************************************************************
+*                        D E F I N I T I O N S                          *
+*************************************************************************/
+/* Domain separation between the fingerprint and the power-up noise streams. */
+#define SRAM_SIM_NOISE_DOMAIN          UINT64_C(0xA0761D6478BD642F)
+
+typedef struct sram_sim_rng {
+    uint64_t state;
+} sram_sim_rng_t;
+
+
+/****************************************************************************
+*                     P R I V A T E  F U N C T I O N S                      *
+*****************************************************************************/
+/* splitmix64: small, fast and good enough for a statistical model. */
+static uint64_t sram_sim_next(sram_sim_rng_t * const rng)
+{
+    uint64_t z;
+
+    rng->state += UINT64_C(0x9E3779B97F4A7C15);
+    z = rng->state;
+    z = (z ^ (z >> 30)) * UINT64_C(0xBF58476D1CE4E5B9);
+    z = (z ^ (z >> 27)) * UINT64_C(0x94D049BB133111EB);
+
+    return z ^ (z >> 31);
+}
+
+/* Converts a rate in ppm into a threshold on a uniform 32-bit value. */
+static uint64_t sram_sim_threshold(const uint32_t rate_ppm)
+{
+    return (((uint64_t)rate_ppm) << 32) / IID_SRAM_SIM_PPM;
+}
+
+/* Returns a 32-bit word in which every bit is set with the probability
+   given by threshold. Two bits are drawn per 64-bit random value. */
+static uint32_t sram_sim_word(      sram_sim_rng_t * const rng,
+                              const uint64_t               threshold)
+{
+    uint32_t word = 0;
+    uint32_t bit;
+    uint64_t r;
+
+    if (threshold == 0)
+    {
+        return 0;
+    }
+
+    if (threshold >= (UINT64_C(1) << 32))
+    {
+        return UINT32_C(0xFFFFFFFF);
+    }
+
+    for (bit = 0; bit < WORD_BIT; bit += 2)
+    {
+        r = sram_sim_next(rng);
+
+        if ((r & UINT32_C(0xFFFFFFFF)) < threshold)
+        {
+            word |= UINT32_C(1) << bit;
+        }
+
+        if ((r >> 32) < threshold)
+        {
+            word |= UINT32_C(1) << (bit + 1);
+        }
+    }
+
+    return word;
+}
+
+
+/****************************************************************************
+*                      P U B L I C  F U N C T I O N S                       *
+*****************************************************************************/
+iid_return_t iid_sram_sim_power_up(const iid_sram_sim_config_t * const config,
+                                   const uint32_t                      power_up,
+                                         uint8_t               * const sram_puf,
+                                   const uint16_t                      sram_puf_size)
+{
+    sram_sim_rng_t fingerprint;
+    sram_sim_rng_t noise;
+    uint64_t       bias_threshold;
+    uint64_t       error_threshold;
+    uint32_t       word;
+    uint16_t       offset;
+
+    if ((config == NULL) || (sram_puf == NULL) ||
+        ((((uintptr_t)sram_puf) % WORD_BYTE) != 0) ||
+        (sram_puf_size == 0) || ((sram_puf_size % WORD_BYTE) != 0) ||
+        (config->bias_ppm > IID_SRAM_SIM_PPM) ||
+        (config->bit_error_rate_ppm > IID_SRAM_SIM_PPM))
+    {
+        return IID_INVALID_PARAMETERS;
+    }
+
+    bias_threshold  = sram_sim_threshold(config->bias_ppm);
+    error_threshold = sram_sim_threshold(config->bit_error_rate_ppm);
+
+    fingerprint.state = config->device_seed;
+    noise.state       = (config->device_seed ^ SRAM_SIM_NOISE_DOMAIN) + (((uint64_t)power_up) << 32);
+    (void)sram_sim_next(&noise);
+
+    for (offset = 0; offset < sram_puf_size; offset += WORD_BYTE)
+    {
+        word  = sram_sim_word(&fingerprint, bias_threshold);
+        word ^= sram_sim_word(&noise, error_threshold);
+
+        iid_memcpy(&sram_puf[offset], &word, WORD_BYTE);
+    }
+
+    return IID_SUCCESS;
+}
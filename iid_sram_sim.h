@@ -0,0 +1,83 @@
+/*
+Copyright (c) 2017, prpl Foundation
+Permission to use, copy, modify, and/or distribute this software for any purpose with or without
+fee is hereby granted, provided that the above copyright notice and this permission notice appear
+in all copies.
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE
+INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE
+FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION,
+ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+#ifndef __IID_SRAM_SIM__H__
+#define __IID_SRAM_SIM__H__
+
+#include "iid_platform.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/*! \addtogroup SramSimulation
+*/
+/*@{*/
+
+/************************************************************************
+*                        D E F I N I T I O N S                          *
+*************************************************************************/
+/*! \brief One million, the unit of the rates in \ref iid_sram_sim_config_t.
+*/
+#define IID_SRAM_SIM_PPM               1000000UL
+
+/*! \brief Model of a simulated SRAM PUF.
+
+    \details The start-up pattern of a simulated device consists of a fingerprint,
+             fully determined by device_seed, on top of which independent noise is
+             added at every power-up. The fraction of ones in the fingerprint is set
+             by bias_ppm and the probability of a bit differing from the fingerprint
+             at a power-up is set by bit_error_rate_ppm.
+*/
+typedef struct iid_sram_sim_config {
+    uint64_t device_seed;        /*!< Identifies the simulated device. */
+    uint32_t bias_ppm;           /*!< Fraction of ones in the fingerprint, in [0, \ref IID_SRAM_SIM_PPM]. Use \ref IID_SRAM_SIM_PPM / 2 for an unbiased device. */
+    uint32_t bit_error_rate_ppm; /*!< Probability of a bit flip at a power-up, in [0, \ref IID_SRAM_SIM_PPM]. */
+} iid_sram_sim_config_t;
+
+
+/****************************************************************************
+*                      P U B L I C  I N T E R F A C E                       *
+*****************************************************************************/
+/*! \brief Simulate the power-up of SRAM PUF memory.
+
+    \details Fills a buffer with the start-up data that the simulated device described
+             by \ref config shows at its power-up number \ref power_up. The result only
+             depends on \ref config and \ref power_up, so every simulated power-up can be
+             reproduced. The buffer can then be passed to \ref bk_init in place of
+             physical SRAM, which allows running the whole Broadkey flow on hosts
+             without an SRAM PUF.
+
+    \param[in] *config Pointer to the model of the simulated device.
+
+    \param[in] power_up Number of the simulated power-up. Distinct values give
+                        independent noise on top of the same fingerprint.
+
+    \param[out] *sram_puf Pointer to the buffer that will hold the simulated start-up data.
+                          Its address must be aligned to 32 bits.
+
+    \param[in] sram_puf_size The size in bytes of \ref sram_puf. It must be a multiple of 4.
+
+    \returns \ref IID_SUCCESS if success, otherwise another return code.
+*/
+iid_return_t iid_sram_sim_power_up(const iid_sram_sim_config_t * const config,
+                                   const uint32_t                      power_up,
+                                         uint8_t               * const sram_puf,
+                                   const uint16_t                      sram_puf_size);
+
+/*@}*/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __IID_SRAM_SIM__H__ */
@@ -29,6 +29,19 @@ extern "C"
 
 #define BK_KEY_CODE_HEADER_SIZE_BYTES  44
 
+#define BK_KEY_CACHE_ENTRY_SIZE_BYTES  76
+
+#define BK_BUNDLE_HEADER_SIZE_BYTES    44
+#define BK_BUNDLE_ENTRY_OVERHEAD_BYTES 20
+
+/*! \brief Size in bytes of a key code bundle, see \ref bk_wrap_bundle.
+
+    \details \ref count is the number of keys and \ref total_key_length the sum of
+             their lengths in bytes.
+*/
+#define BK_BUNDLE_SIZE_BYTES(count, total_key_length) \
+    (BK_BUNDLE_HEADER_SIZE_BYTES + ((count) * BK_BUNDLE_ENTRY_OVERHEAD_BYTES) + (total_key_length))
+
 /*! \brief Defines the key types used in the \ref bk_get_key function.
 */
 typedef enum key_type {
@@ -45,6 +58,99 @@ typedef enum key_type {
     E_SECP521R1    = 0x45300209
 } key_type_t;
 
+/*! \brief Size in bytes of a key generated by \ref bk_get_key for \ref key_type.
+
+    \details The low 16 bits of every \ref key_type_t value hold the key size in bits.
+*/
+#define BK_KEY_SIZE_BYTES(key_type)    (((((uint32_t)(key_type)) & 0xFFFFU) + 7U) / 8U)
+
+/*! \brief Defines the cipher and MAC kernels used by \ref bk_wrap and \ref bk_unwrap.
+
+    \details All backends produce identical key codes.
+*/
+typedef enum bk_crypto_backend {
+    BK_CRYPTO_BACKEND_AUTO         = 0x00, /*!< Fastest backend supported by the CPU. */
+    BK_CRYPTO_BACKEND_PORTABLE     = 0x01, /*!< Portable C implementation. */
+    BK_CRYPTO_BACKEND_AESNI        = 0x02, /*!< x86 AES-NI and PCLMULQDQ. */
+    BK_CRYPTO_BACKEND_VAES         = 0x03, /*!< x86 VAES and VPCLMULQDQ. */
+    BK_CRYPTO_BACKEND_ARMV8_CE     = 0x04  /*!< ARMv8 cryptography extensions. */
+} bk_crypto_backend_t;
+
+/*! \brief Defines when \ref bk_start reconstructs the intrinsic key.
+*/
+typedef enum bk_start_mode {
+    BK_START_EAGER                 = 0x00, /*!< Reconstruct in \ref bk_start (default). */
+    BK_START_LAZY                  = 0x01  /*!< Reconstruct on first use or in \ref bk_prewarm. */
+} bk_start_mode_t;
+
+/*! \brief Describes one key derivation in a \ref bk_get_key_batch call.
+*/
+typedef struct bk_key_request {
+    key_type_t           key_type;  /*!< Type of the key to generate, see \ref key_type_t. */
+    uint8_t              index;     /*!< Index between 0 and 255 associated to the key. */
+    uint8_t            * key;       /*!< Output buffer, sized as described in \ref bk_get_key. */
+    iid_return_t         status;    /*!< Result of this derivation, set by \ref bk_get_key_batch. */
+} bk_key_request_t;
+
+/*! \brief Describes one key in a \ref bk_wrap_batch call.
+*/
+typedef struct bk_wrap_request {
+    uint8_t              index;      /*!< Index between 0 and 255 associated to the key. */
+    const uint8_t      * key;        /*!< Key to wrap, 32-bit aligned. */
+    uint16_t             key_length; /*!< Length of key in bytes, in [4, 1024] and a multiple of 4. */
+    uint8_t            * key_code;   /*!< Output buffer of \ref BK_KEY_CODE_HEADER_SIZE_BYTES + key_length bytes, 32-bit aligned. */
+    iid_return_t         status;     /*!< Result of this wrap, set by \ref bk_wrap_batch. */
+} bk_wrap_request_t;
+
+/*! \brief Describes one key code in a \ref bk_unwrap_batch call.
+*/
+typedef struct bk_unwrap_request {
+    const uint8_t      * key_code;   /*!< Key code generated by \ref bk_wrap, 32-bit aligned. */
+    uint8_t            * key;        /*!< Output buffer for the unwrapped key, 32-bit aligned. */
+    uint16_t             key_length; /*!< Length in bytes of the unwrapped key, set by \ref bk_unwrap_batch. */
+    uint8_t              index;      /*!< Index associated to the key, set by \ref bk_unwrap_batch. */
+    iid_return_t         status;     /*!< Result of this unwrap, set by \ref bk_unwrap_batch. */
+} bk_unwrap_request_t;
+
+/*! \brief Describes one key in a \ref bk_wrap_bundle call.
+*/
+typedef struct bk_bundle_entry {
+    uint8_t              index;      /*!< Index between 0 and 255 associated to the key. */
+    const uint8_t      * key;        /*!< Key to wrap, 32-bit aligned. */
+    uint16_t             key_length; /*!< Length of key in bytes, in [4, 1024] and a multiple of 4. */
+} bk_bundle_entry_t;
+
+/*! \brief Describes one fragment of a key in a \ref bk_wrapv call.
+*/
+typedef struct bk_const_iovec {
+    const uint8_t      * base;       /*!< First byte of the fragment, with any alignment. */
+    uint16_t             length;     /*!< Length of the fragment in bytes, possibly 0. */
+} bk_const_iovec_t;
+
+/*! \brief Describes one fragment of a key in a \ref bk_unwrapv call.
+*/
+typedef struct bk_iovec {
+    uint8_t            * base;       /*!< First byte of the fragment, with any alignment. */
+    uint16_t             length;     /*!< Length of the fragment in bytes, possibly 0. */
+} bk_iovec_t;
+
+/*! \brief Opaque Broadkey context.
+
+    \details A context holds all state of one Broadkey instance: the SRAM PUF
+             region it uses, the intrinsic key and the other internally generated
+             keys. Distinct contexts share no mutable state. The memory backing a
+             context is provided by the caller, see \ref bk_ctx_get_size.
+*/
+typedef struct bk_ctx bk_ctx_t;
+
+/*! \brief Statistics of the derived-key cache, see \ref bk_enable_key_cache.
+*/
+typedef struct bk_key_cache_stats {
+    uint32_t             hits;      /*!< Number of \ref bk_get_key calls served from the cache. */
+    uint32_t             misses;    /*!< Number of \ref bk_get_key calls that derived the key. */
+    uint16_t             entries;   /*!< Number of entries the cache can hold. */
+} bk_key_cache_stats_t;
+
 
 /****************************************************************************
 *                      P U B L I C  I N T E R F A C E                       *
@@ -67,10 +173,19 @@ iid_return_t bk_get_software_version(uint8_t * const major_version,
 
     \details This function initializes the Broadkey module and it must
              be called prior to any other Broadkey function call.
+             It also selects the cipher and MAC backend from the features of
+             the CPU, see \ref bk_set_crypto_backend.
 
     \param[in] *sram_puf Pointer to physical SRAM that will be used
                 by Broadkey as PUF memory.
                 Its address must be aligned to 32 bits.
+                This function only records the pointer: the memory is read by
+                \ref bk_enroll and \ref bk_start, and in the \ref BK_START_LAZY
+                mode by the deferred reconstruction. It must stay valid and must
+                not be written until that read is done, that is until
+                \ref bk_enroll or \ref bk_start has returned, or in the
+                \ref BK_START_LAZY mode until \ref bk_prewarm or the first call
+                that uses the intrinsic key has returned.
 
     \param[in] sram_puf_size The size in bytes of available SRAM PUF that can
                              be used by Broadkey. It must be of at least
@@ -86,6 +201,9 @@ iid_return_t bk_init(      uint8_t  * const sram_puf,
 
     \details Activation code is generated by this function call based on
              the PUF memory.
+             The keyed state shared by all later key derivations, wraps and unwraps
+             is computed once here, so that \ref bk_get_key, \ref bk_wrap and
+             \ref bk_unwrap only process the blocks specific to their own input.
 
     \param[out] *activation_code Pointer to an array of bytes of size defined by
                                  \ref BK_AC_SIZE_BYTES that will contain the
@@ -101,6 +219,14 @@ iid_return_t bk_enroll(uint8_t * const activation_code);
 
     \details Reconstructs the intrinsic key using the PUF area of SRAM and the
              activation code given as a parameter.
+             As in \ref bk_enroll, the keyed state shared by all later key derivations,
+             wraps and unwraps is computed once here.
+             The checks of \ref bk_check_activation_code are done first, so that an
+             activation code they reject costs no reconstruction work.
+             In the \ref BK_START_LAZY mode this function only does those checks and
+             keeps a copy of the activation code; the reconstruction is deferred,
+             see \ref bk_set_start_mode. The PUF memory given to \ref bk_init is
+             then read later, and must be left untouched until it has been.
 
     \param[in] *activation_code Pointer to an array of bytes containing an activation
                                 code, previously generated by \ref bk_enroll function
@@ -113,11 +239,85 @@ iid_return_t bk_enroll(uint8_t * const activation_code);
 iid_return_t bk_start(const uint8_t * const activation_code);
 
 
+/*! \brief Check an activation code without reconstructing the intrinsic key.
+
+    \details Verifies the format and integrity of the activation code and whether
+             it belongs to the device whose PUF memory was given to \ref bk_init.
+             These checks take a small fraction of the time of \ref bk_start.
+             An activation code rejected by this function is always rejected by
+             \ref bk_start. An activation code accepted by this function can still be
+             rejected by \ref bk_start.
+             It can be called after \ref bk_init and does not change the state of
+             the module.
+
+    \param[in] *activation_code Pointer to an array of bytes containing an activation
+                                code, as for \ref bk_start.
+                                Its address must be aligned to 32 bits.
+
+    \returns \ref IID_SUCCESS if the activation code passed the checks,
+             \ref IID_INVALID_AC if it did not, otherwise another return code.
+*/
+iid_return_t bk_check_activation_code(const uint8_t * const activation_code);
+
+
+/*! \brief Select when the intrinsic key is reconstructed.
+
+    \details In the \ref BK_START_LAZY mode, \ref bk_start returns once the activation
+             code has been checked and recorded. The reconstruction is done exactly once,
+             by the first call to \ref bk_get_key, \ref bk_wrap, \ref bk_unwrap, one of
+             their batch variants or \ref bk_prewarm. Concurrent first calls wait for that
+             single reconstruction. If it fails, that call and every later one until
+             \ref bk_stop return \ref IID_INVALID_AC.
+             It can only be called when the module is neither enrolled nor started,
+             otherwise \ref IID_NOT_ALLOWED is returned. The mode is kept across
+             \ref bk_stop.
+
+    \param[in] mode Value that specifies the start mode. Its value must be one of the
+                    values enumerated in \ref bk_start_mode_t.
+
+    \returns \ref IID_SUCCESS if success, otherwise another return code.
+*/
+iid_return_t bk_set_start_mode(const bk_start_mode_t mode);
+
+
+/*! \brief Reconstruct the intrinsic key now.
+
+    \details Forces the reconstruction deferred by \ref bk_start in the
+             \ref BK_START_LAZY mode. It does nothing when the reconstruction
+             has already been done, or in the \ref BK_START_EAGER mode.
+             It can be called after start.
+
+    \returns \ref IID_SUCCESS if the intrinsic key is available, \ref IID_INVALID_AC if
+             the reconstruction failed, otherwise another return code.
+*/
+iid_return_t bk_prewarm(void);
+
+
 /*! \brief Finalize Broadkey usage.
 
     \details Cleans internal Broadkey data that was filled in response to
              \ref bk_start and \bk_enroll calls (intrinsic and other
-             internally generated/used keys).
+             internally generated/used keys, and the keyed state precomputed
+             from them).
+
+             Once \ref bk_enroll or \ref bk_start has returned \ref IID_SUCCESS, the
+             internal data is read-only until this function is called. The only
+             exception is the derived-key cache, whose entries are filled and published
+             as described in \ref bk_enable_key_cache. In the \ref BK_START_LAZY mode
+             the internal data is only complete once the deferred reconstruction is
+             done. That reconstruction writes it once, and publishes it with release
+             ordering before any call can use it. Calls that arrive earlier wait for it,
+             see \ref bk_set_start_mode. From then on it is read-only as well. In that
+             period \ref bk_get_key, \ref bk_wrap, \ref bk_unwrap and their batch
+             variants may be called concurrently from any number of threads, without
+             locking and without further synchronization by the caller.
+             This function may be called while such calls are in progress: calls that
+             start after it do not use the internal data and return \ref IID_NOT_ALLOWED,
+             and it waits for the calls already in progress to complete (a grace period)
+             before cleaning the internal data. It must not be called concurrently with
+             \ref bk_init, \ref bk_enroll, \ref bk_start or itself.
+             When the derived-key cache is enabled its entries are zeroized as well,
+             see \ref bk_enable_key_cache.
 
     \returns \ref IID_SUCCESS if success, otherwise another return code.
 */
@@ -127,7 +327,10 @@ iid_return_t bk_stop(void);
 /*! \brief Get a device-specific key.
 
     \details This function generates either a symmetric or ECC private device-specific key.
+             When the derived-key cache is enabled, a key that was generated before is
+             copied from the cache instead, see \ref bk_enable_key_cache.
              It can be called after enrollment or start.
+             It can be called concurrently from several threads, see \ref bk_stop.
 
     \param[in] key_type Value that specifies the type of the key which will be generated.
                         Its value must be one of the values enumerated in \ref key_type_t.
@@ -153,10 +356,36 @@ iid_return_t bk_get_key(const key_type_t         key_type,
                               uint8_t    * const key);
 
 
+/*! \brief Get several device-specific keys in one call.
+
+    \details This function generates every key described by \ref requests, exactly as
+             a sequence of \ref bk_get_key calls would, but performs the setup that is
+             common to all derivations only once per call. Independent derivations are
+             processed in parallel by the multi-buffer engine where the CPU supports it.
+             It can be called after enrollment or start.
+             It can be called concurrently from several threads, see \ref bk_stop.
+
+    \param[in,out] *requests Pointer to an array of \ref bk_key_request_t descriptors.
+                             For each descriptor the key_type, index and key fields
+                             follow the rules of the matching \ref bk_get_key parameters.
+                             On return, the status field of every descriptor holds the
+                             return code of its own derivation.
+
+    \param[in] count Number of descriptors in \ref requests. Must be at least 1.
+
+    \returns \ref IID_SUCCESS if all keys were generated, otherwise the return code of the
+             first descriptor that failed. Descriptors that fail do not prevent the
+             remaining ones from being processed.
+*/
+iid_return_t bk_get_key_batch(      bk_key_request_t * const requests,
+                              const uint16_t                 count);
+
+
 /*! \brief Wrap a key into a key code.
 
     \details This functions wraps a key into a key code.
              It can be called after enrollment or start.
+             It can be called concurrently from several threads, see \ref bk_stop.
 
     \param[in] index Value between 0 and 255 specifying the index associated to the
                      key that will be generated.
@@ -185,6 +414,7 @@ iid_return_t bk_wrap(const uint8_t          index,
 
     \details This functions unwraps a key code into a key.
              It can be called after enrollment or start.
+             It can be called concurrently from several threads, see \ref bk_stop.
 
     \param[in] *key_code Pointer to an array of bytes that holds the key code generated by
                          \ref bk_wrap.
@@ -211,6 +441,486 @@ iid_return_t bk_unwrap(const uint8_t  * const key_code,
                              uint8_t  * const index);
 
 
+/*! \brief Wrap a key held in several fragments into a key code.
+
+    \details The key is the concatenation of the fragments described by \ref segments,
+             in order. The fragments are read in place, one after the other, across their
+             boundaries; they are not first copied into one contiguous buffer. The
+             resulting key code is identical to the one \ref bk_wrap produces for the
+             same index and concatenated key.
+             It can be called after enrollment or start.
+             It can be called concurrently from several threads, see \ref bk_stop.
+
+    \param[in] index Value between 0 and 255 specifying the index associated to the key.
+
+    \param[in] *segments Pointer to an array of \ref bk_const_iovec_t descriptors. The
+                         fragments may have any address and length. Their total length
+                         must be in the [4, 1024] range and a multiple of 4.
+
+    \param[in] segment_count Number of descriptors in \ref segments. Must be at least 1.
+
+    \param[out] *key_code Pointer to an array of bytes which will hold the wrapped key.
+                          Its size in bytes must be of \ref BK_KEY_CODE_HEADER_SIZE_BYTES +
+                          the total length of the fragments.
+                          Its address must be aligned to 32 bits.
+
+    \returns \ref IID_SUCCESS if success, otherwise another return code.
+*/
+iid_return_t bk_wrapv(const uint8_t                  index,
+                      const bk_const_iovec_t * const segments,
+                      const uint16_t                 segment_count,
+                            uint8_t          * const key_code);
+
+
+/*! \brief Unwrap a key code into several fragments.
+
+    \details The key is written across the fragments described by \ref segments, in
+             order, filling each one before moving to the next. The key code is
+             authenticated before any byte is written, so nothing is written to the
+             fragments when it fails authentication. Space left after the key in the
+             fragments is not modified.
+             It can be called after enrollment or start.
+             It can be called concurrently from several threads, see \ref bk_stop.
+
+    \param[in] *key_code Pointer to an array of bytes that holds the key code generated by
+                         \ref bk_wrap or \ref bk_wrapv.
+                         Its address must be aligned to 32 bits.
+
+    \param[in] *segments Pointer to an array of \ref bk_iovec_t descriptors. The fragments
+                         may have any address and length. Their total length must be at
+                         least the length of the key, otherwise \ref IID_INVALID_PARAMETERS
+                         is returned and nothing is written.
+
+    \param[in] segment_count Number of descriptors in \ref segments. Must be at least 1.
+
+    \param[out] *key_length Pointer to a byte buffer which will contain the size in bytes
+                            of the key.
+                            Its value will be in the [4, 1024] range and a multiple of 4.
+
+    \param[out] *index Pointer to a byte buffer which will contain the index associated to
+                       the key.
+
+    \returns \ref IID_SUCCESS if success, otherwise another return code.
+*/
+iid_return_t bk_unwrapv(const uint8_t    * const key_code,
+                        const bk_iovec_t * const segments,
+                        const uint16_t           segment_count,
+                              uint16_t   * const key_length,
+                              uint8_t    * const index);
+
+
+/*! \brief Wrap several keys into key codes in one call.
+
+    \details This function wraps every key described by \ref requests. The cipher and
+             MAC work of the different keys is interleaved, but each resulting key code
+             is identical to the one \ref bk_wrap would produce for the same index and key.
+             Keys of different lengths may be mixed in one call.
+             It can be called after enrollment or start.
+             It can be called concurrently from several threads, see \ref bk_stop.
+
+    \param[in,out] *requests Pointer to an array of \ref bk_wrap_request_t descriptors.
+                             For each descriptor the index, key, key_length and key_code
+                             fields follow the rules of the matching \ref bk_wrap parameters.
+                             On return, the status field of every descriptor holds the
+                             return code of its own wrap.
+
+    \param[in] count Number of descriptors in \ref requests. Must be at least 1.
+
+    \returns \ref IID_SUCCESS if all keys were wrapped, otherwise the return code of the
+             first descriptor that failed. Descriptors that fail do not prevent the
+             remaining ones from being processed.
+*/
+iid_return_t bk_wrap_batch(      bk_wrap_request_t * const requests,
+                           const uint16_t                  count);
+
+
+/*! \brief Unwrap several key codes into keys in one call.
+
+    \details This function unwraps every key code described by \ref requests. The cipher
+             and MAC work of the different key codes is interleaved, but each resulting
+             key, length and index is identical to what \ref bk_unwrap would return for the
+             same key code. Key codes of different lengths may be mixed in one call.
+             It can be called after enrollment or start.
+             It can be called concurrently from several threads, see \ref bk_stop.
+
+    \param[in,out] *requests Pointer to an array of \ref bk_unwrap_request_t descriptors.
+                             For each descriptor the key_code and key fields follow the
+                             rules of the matching \ref bk_unwrap parameters.
+                             On return, the status field of every descriptor holds the
+                             return code of its own unwrap, \ref IID_INVALID_KEY_CODE
+                             when that key code fails authentication. The key_length and
+                             index fields are only valid when status is \ref IID_SUCCESS.
+
+    \param[in] count Number of descriptors in \ref requests. Must be at least 1.
+
+    \returns \ref IID_SUCCESS if all key codes were unwrapped, otherwise the return code
+             of the first descriptor that failed. Descriptors that fail do not prevent the
+             remaining ones from being processed.
+*/
+iid_return_t bk_unwrap_batch(      bk_unwrap_request_t * const requests,
+                             const uint16_t                    count);
+
+
+/*! \brief Wrap several keys into one key code bundle.
+
+    \details A bundle carries one header of \ref BK_BUNDLE_HEADER_SIZE_BYTES bytes shared by
+             all its keys, a table with the index and length of every key, and every key
+             encrypted and authenticated on its own, with \ref BK_BUNDLE_ENTRY_OVERHEAD_BYTES
+             bytes of overhead per key in total. For small keys a bundle is therefore much
+             smaller than the equivalent key codes of \ref bk_wrap. Any single key can be
+             unwrapped with \ref bk_unwrap_bundle_entry.
+             It can be called after enrollment or start.
+             It can be called concurrently from several threads, see \ref bk_stop.
+
+    \param[in] *entries Pointer to an array of \ref bk_bundle_entry_t descriptors. For each
+                        descriptor the fields follow the rules of the matching \ref bk_wrap
+                        parameters.
+
+    \param[in] count Number of descriptors in \ref entries. Must be at least 1.
+
+    \param[out] *bundle Pointer to an array of bytes which will hold the bundle.
+                        Its address must be aligned to 32 bits.
+
+    \param[in] bundle_size The size in bytes of \ref bundle. It must be of at least
+                           \ref BK_BUNDLE_SIZE_BYTES for the given keys.
+
+    \returns \ref IID_SUCCESS if success, otherwise another return code.
+*/
+iid_return_t bk_wrap_bundle(const bk_bundle_entry_t * const entries,
+                            const uint16_t                  count,
+                                  uint8_t           * const bundle,
+                            const uint32_t                  bundle_size);
+
+
+/*! \brief Unwrap one key of a key code bundle.
+
+    \details The shared header and the whole table are authenticated, then only the
+             entry at \ref position is authenticated and decrypted. The table holds a few
+             bytes per key, so the cost grows linearly with the number of keys in the
+             bundle, but with a much smaller slope than unwrapping every key; the other
+             keys are never decrypted.
+             It can be called after enrollment or start.
+             It can be called concurrently from several threads, see \ref bk_stop.
+
+    \param[in] *bundle Pointer to an array of bytes that holds a bundle generated by
+                       \ref bk_wrap_bundle. Its address must be aligned to 32 bits.
+
+    \param[in] bundle_size The size in bytes of \ref bundle.
+
+    \param[in] position Position of the key in the bundle, starting from 0, in the order
+                        of the entries given to \ref bk_wrap_bundle.
+
+    \param[out] *key Pointer to an array of bytes which will hold the unwrapped key.
+                     Its size in bytes must be at least the length of that key, at most
+                     1024. Its address must be aligned to 32 bits.
+
+    \param[out] *key_length Pointer to a buffer which will contain the size in bytes of
+                            \ref key.
+
+    \param[out] *index Pointer to a byte buffer which will contain the index associated to
+                       \ref key.
+
+    \returns \ref IID_SUCCESS if success, \ref IID_INVALID_KEY_CODE if the bundle or the
+             entry fails authentication, \ref IID_INVALID_PARAMETERS if \ref position is
+             not in the bundle, otherwise another return code.
+*/
+iid_return_t bk_unwrap_bundle_entry(const uint8_t  * const bundle,
+                                    const uint32_t         bundle_size,
+                                    const uint16_t         position,
+                                          uint8_t  * const key,
+                                          uint16_t * const key_length,
+                                          uint8_t  * const index);
+
+
+/*! \brief Enable the derived-key cache.
+
+    \details Once enabled, keys generated by \ref bk_get_key and \ref bk_get_key_batch
+             are stored in the cache, and later requests for the same key type and index
+             are served from it. The cache is direct-mapped on the key type and index, so
+             a lookup takes constant time; a new key replaces the entry it maps to.
+             Every entry is zeroized by \ref bk_stop and by \ref bk_disable_key_cache.
+
+             An entry of \ref BK_KEY_CACHE_ENTRY_SIZE_BYTES bytes holds, in order, a
+             32-bit sequence counter, the key padded from at most 66 to 68 bytes, and a
+             32-bit tag made of the key type and the index.
+
+             The sequence counter makes concurrent fills and hits of an entry safe without a
+             lock (a seqlock). A call that fills an entry first moves its counter from an
+             even to an odd value with an atomic compare-and-swap. It then writes the key,
+             key type and index, and moves the counter back to an even value with release
+             ordering. If the counter is already odd, another call is filling the entry, so
+             this call leaves the entry alone and returns the key it derived. A call that
+             looks up an entry reads the counter with acquire ordering, copies the key, and
+             reads the counter again. If the counter was odd or has changed, the lookup
+             counts as a miss and the key is derived. Neither side waits for the other, and
+             a torn key is never returned.
+             The cache is disabled by default. It can only be enabled when the module is
+             neither enrolled nor started, otherwise \ref IID_NOT_ALLOWED is returned.
+
+    \param[in] *cache Pointer to an array of bytes which will hold the cache entries.
+                      Its address must be aligned to 32 bits. It must stay valid until
+                      \ref bk_disable_key_cache has returned.
+
+    \param[in] cache_size The size in bytes of \ref cache. It must be a non-zero multiple
+                          of \ref BK_KEY_CACHE_ENTRY_SIZE_BYTES.
+
+    \returns \ref IID_SUCCESS if success, otherwise another return code.
+*/
+iid_return_t bk_enable_key_cache(      uint8_t  * const cache,
+                                 const uint16_t         cache_size);
+
+
+/*! \brief Disable the derived-key cache.
+
+    \details Zeroizes every cache entry and stops using the memory given to
+             \ref bk_enable_key_cache. The statistics are reset.
+             It can only be called when the module is neither enrolled nor started,
+             otherwise \ref IID_NOT_ALLOWED is returned.
+
+    \returns \ref IID_SUCCESS if success, otherwise another return code.
+*/
+iid_return_t bk_disable_key_cache(void);
+
+
+/*! \brief Get the statistics of the derived-key cache.
+
+    \param[out] *stats Pointer to a structure which will hold the statistics.
+
+    \returns \ref IID_SUCCESS if success, \ref IID_NOT_ALLOWED if the cache is not
+             enabled, otherwise another return code.
+*/
+iid_return_t bk_get_key_cache_stats(bk_key_cache_stats_t * const stats);
+
+
+/*! \brief Select the cipher and MAC backend.
+
+    \details Overrides the backend selected by \ref bk_init, for instance to compare
+             the key codes of every backend in a known-answer test.
+             It can be called after \ref bk_init, when the module is neither enrolled
+             nor started, otherwise \ref IID_NOT_ALLOWED is returned.
+
+    \param[in] backend Value that specifies the backend to use. Its value must be one of
+                       the values enumerated in \ref bk_crypto_backend_t.
+                       \ref BK_CRYPTO_BACKEND_AUTO restores the choice of \ref bk_init.
+
+    \returns \ref IID_SUCCESS if success, \ref IID_INVALID_PARAMETERS if the backend
+             is not supported by this build or this CPU, otherwise another return code.
+*/
+iid_return_t bk_set_crypto_backend(const bk_crypto_backend_t backend);
+
+
+/*! \brief Get the cipher and MAC backend in use.
+
+    \param[out] *backend Pointer to a buffer which will hold the backend in use.
+                         It is never \ref BK_CRYPTO_BACKEND_AUTO.
+
+    \returns \ref IID_SUCCESS if success, otherwise another return code.
+*/
+iid_return_t bk_get_crypto_backend(bk_crypto_backend_t * const backend);
+
+
+/****************************************************************************
+*                     C O N T E X T  I N T E R F A C E                      *
+*****************************************************************************/
+/* Every function below behaves exactly as the function of the same name
+   without the ctx_ prefix, but operates on the given context instead of the
+   default one. The functions of the public interface above are equivalent to
+   calling their context variant with \ref bk_get_default_ctx.
+   Calls on distinct contexts may run concurrently from different threads.
+   Calls on the same context follow the rules described in \ref bk_stop. */
+
+/*! \brief Get the size of a Broadkey context.
+
+    \details Get the number of bytes the caller must provide to \ref bk_ctx_init
+             for one context.
+
+    \param[out] *ctx_size Pointer to a buffer for holding the size in bytes of a context.
+
+    \returns \ref IID_SUCCESS if success, otherwise another return code.
+*/
+iid_return_t bk_ctx_get_size(uint16_t * const ctx_size);
+
+
+/*! \brief Get the default Broadkey context.
+
+    \details Get the context used by the functions of the public interface.
+
+    \returns Pointer to the default context. It is never NULL.
+*/
+bk_ctx_t * bk_get_default_ctx(void);
+
+
+/*! \brief Initializes a Broadkey context.
+
+    \details See \ref bk_init. This function must be called on a context prior
+             to any other function call on that context.
+
+    \param[out] *ctx Pointer to caller-provided memory of the size returned by
+                     \ref bk_ctx_get_size. Its address must be aligned to 32 bits.
+                     The memory must stay valid until \ref bk_ctx_stop has returned.
+
+    \param[in] *sram_puf See \ref bk_init. Distinct contexts must use distinct
+                         SRAM PUF regions.
+
+    \param[in] sram_puf_size See \ref bk_init.
+
+    \returns \ref IID_SUCCESS if success, otherwise another return code.
+*/
+iid_return_t bk_ctx_init(      bk_ctx_t * const ctx,
+                               uint8_t  * const sram_puf,
+                         const uint16_t         sram_puf_size);
+
+
+/*! \brief Enrolls a Broadkey context. See \ref bk_enroll.
+*/
+iid_return_t bk_ctx_enroll(bk_ctx_t * const ctx,
+                           uint8_t  * const activation_code);
+
+
+/*! \brief Reconstructs the intrinsic key of a context. See \ref bk_start.
+*/
+iid_return_t bk_ctx_start(      bk_ctx_t * const ctx,
+                          const uint8_t  * const activation_code);
+
+
+/*! \brief Check an activation code against a context. See \ref bk_check_activation_code.
+*/
+iid_return_t bk_ctx_check_activation_code(      bk_ctx_t * const ctx,
+                                          const uint8_t  * const activation_code);
+
+
+/*! \brief Select when the intrinsic key of a context is reconstructed. See \ref bk_set_start_mode.
+*/
+iid_return_t bk_ctx_set_start_mode(      bk_ctx_t        * const ctx,
+                                   const bk_start_mode_t         mode);
+
+
+/*! \brief Reconstruct the intrinsic key of a context now. See \ref bk_prewarm.
+*/
+iid_return_t bk_ctx_prewarm(bk_ctx_t * const ctx);
+
+
+/*! \brief Finalize the usage of a context. See \ref bk_stop.
+*/
+iid_return_t bk_ctx_stop(bk_ctx_t * const ctx);
+
+
+/*! \brief Get a device-specific key from a context. See \ref bk_get_key.
+*/
+iid_return_t bk_ctx_get_key(      bk_ctx_t   * const ctx,
+                            const key_type_t         key_type,
+                            const uint8_t            index,
+                                  uint8_t    * const key);
+
+
+/*! \brief Get several device-specific keys from a context. See \ref bk_get_key_batch.
+*/
+iid_return_t bk_ctx_get_key_batch(      bk_ctx_t         * const ctx,
+                                        bk_key_request_t * const requests,
+                                  const uint16_t                 count);
+
+
+/*! \brief Wrap a key into a key code with a context. See \ref bk_wrap.
+*/
+iid_return_t bk_ctx_wrap(      bk_ctx_t * const ctx,
+                         const uint8_t          index,
+                         const uint8_t  * const key,
+                         const uint16_t         key_length,
+                               uint8_t  * const key_code);
+
+
+/*! \brief Unwrap a key code into a key with a context. See \ref bk_unwrap.
+*/
+iid_return_t bk_ctx_unwrap(      bk_ctx_t * const ctx,
+                           const uint8_t  * const key_code,
+                                 uint8_t  * const key,
+                                 uint16_t * const key_length,
+                                 uint8_t  * const index);
+
+
+/*! \brief Wrap a key held in several fragments with a context. See \ref bk_wrapv.
+*/
+iid_return_t bk_ctx_wrapv(      bk_ctx_t         * const ctx,
+                          const uint8_t                  index,
+                          const bk_const_iovec_t * const segments,
+                          const uint16_t                 segment_count,
+                                uint8_t          * const key_code);
+
+
+/*! \brief Unwrap a key code into several fragments with a context. See \ref bk_unwrapv.
+*/
+iid_return_t bk_ctx_unwrapv(      bk_ctx_t   * const ctx,
+                            const uint8_t    * const key_code,
+                            const bk_iovec_t * const segments,
+                            const uint16_t           segment_count,
+                                  uint16_t   * const key_length,
+                                  uint8_t    * const index);
+
+
+/*! \brief Wrap several keys with a context. See \ref bk_wrap_batch.
+*/
+iid_return_t bk_ctx_wrap_batch(      bk_ctx_t          * const ctx,
+                                     bk_wrap_request_t * const requests,
+                               const uint16_t                  count);
+
+
+/*! \brief Unwrap several key codes with a context. See \ref bk_unwrap_batch.
+*/
+iid_return_t bk_ctx_unwrap_batch(      bk_ctx_t            * const ctx,
+                                       bk_unwrap_request_t * const requests,
+                                 const uint16_t                    count);
+
+
+/*! \brief Wrap several keys into one bundle with a context. See \ref bk_wrap_bundle.
+*/
+iid_return_t bk_ctx_wrap_bundle(      bk_ctx_t          * const ctx,
+                                const bk_bundle_entry_t * const entries,
+                                const uint16_t                  count,
+                                      uint8_t           * const bundle,
+                                const uint32_t                  bundle_size);
+
+
+/*! \brief Unwrap one key of a bundle with a context. See \ref bk_unwrap_bundle_entry.
+*/
+iid_return_t bk_ctx_unwrap_bundle_entry(      bk_ctx_t * const ctx,
+                                        const uint8_t  * const bundle,
+                                        const uint32_t         bundle_size,
+                                        const uint16_t         position,
+                                              uint8_t  * const key,
+                                              uint16_t * const key_length,
+                                              uint8_t  * const index);
+
+
+/*! \brief Enable the derived-key cache of a context. See \ref bk_enable_key_cache.
+*/
+iid_return_t bk_ctx_enable_key_cache(      bk_ctx_t * const ctx,
+                                           uint8_t  * const cache,
+                                     const uint16_t         cache_size);
+
+
+/*! \brief Disable the derived-key cache of a context. See \ref bk_disable_key_cache.
+*/
+iid_return_t bk_ctx_disable_key_cache(bk_ctx_t * const ctx);
+
+
+/*! \brief Get the derived-key cache statistics of a context. See \ref bk_get_key_cache_stats.
+*/
+iid_return_t bk_ctx_get_key_cache_stats(bk_ctx_t             * const ctx,
+                                        bk_key_cache_stats_t * const stats);
+
+
+/*! \brief Select the cipher and MAC backend of a context. See \ref bk_set_crypto_backend.
+*/
+iid_return_t bk_ctx_set_crypto_backend(      bk_ctx_t            * const ctx,
+                                       const bk_crypto_backend_t         backend);
+
+
+/*! \brief Get the cipher and MAC backend of a context. See \ref bk_get_crypto_backend.
+*/
+iid_return_t bk_ctx_get_crypto_backend(bk_ctx_t            * const ctx,
+                                       bk_crypto_backend_t * const backend);
+
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,399 @@
+/*
+Copyright (c) 2017, prpl Foundation
+Permission to use, copy, modify, and/or distribute this software for any purpose with or without
+fee is hereby granted, provided that the above copyright notice and this permission notice appear
+in all copies.
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE
+INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE
+FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION,
+ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+#ifndef __IID_BROADKEY__HPP__
+#define __IID_BROADKEY__HPP__
+
+#if __cplusplus < 201703L
+#error "iidbroadkey.hpp requires C++17"
+#endif
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#if defined(__has_include)
+#if __has_include(<version>)
+#include <version>
+#endif
+#endif
+#if defined(__cpp_lib_span)
+#include <span>
+#endif
+
+#include "iidbroadkey.h"
+#include "iidreturn_codes.h"
+
+/* Header-only C++ interface over iidbroadkey.h.
+
+   Errors are reported by throwing bk::error, which carries the iid_return_t
+   of the failing call. Key buffers are bk::secure_array objects. They live on
+   the stack, are 32-bit aligned and are zeroized when destroyed. */
+
+namespace bk {
+
+/************************************************************************
+*                        D E F I N I T I O N S                          *
+*************************************************************************/
+/*! \brief Error returned by a Broadkey function.
+*/
+class error : public std::runtime_error {
+public:
+    explicit error(const iid_return_t code)
+        : std::runtime_error("Broadkey error " + std::to_string(static_cast<unsigned>(code))),
+          code_(code)
+    {
+    }
+
+    /*! \brief The return code of the failing call, see iidreturn_codes.h.
+    */
+    iid_return_t code() const noexcept { return code_; }
+
+private:
+    iid_return_t code_;
+};
+
+namespace detail {
+
+inline void check(const iid_return_t result)
+{
+    if (result != IID_SUCCESS)
+    {
+        throw error(result);
+    }
+}
+
+inline void wipe(void * const buffer, const std::size_t size) noexcept
+{
+    volatile std::uint8_t * p = static_cast<volatile std::uint8_t *>(buffer);
+
+    for (std::size_t i = 0; i < size; i++)
+    {
+        p[i] = 0;
+    }
+}
+
+} // namespace detail
+
+/*! \brief Whether \ref type is one of the values enumerated in \ref key_type_t.
+*/
+constexpr bool is_key_type(const key_type_t type) noexcept
+{
+    switch (type)
+    {
+    case S_128:
+    case S_192:
+    case S_256:
+    case E_SECP192R1:
+    case E_SECP224R1:
+    case E_SECP256R1:
+    case E_SECP384R1:
+    case E_SECP521R1:
+        return true;
+    }
+    return false;
+}
+
+/*! \brief Compile-time properties of a \ref key_type_t.
+*/
+template <key_type_t Type>
+struct key_traits {
+    static_assert(is_key_type(Type), "not a key_type_t value");
+
+    /*! \brief Size in bytes of a key of this type, as written by \ref bk_get_key. */
+    static constexpr std::size_t size = BK_KEY_SIZE_BYTES(Type);
+};
+
+/*! \brief Size in bytes of a key of type \ref Type.
+*/
+template <key_type_t Type>
+inline constexpr std::size_t key_size_v = key_traits<Type>::size;
+
+static_assert(key_size_v<S_128>       == 16, "S_128");
+static_assert(key_size_v<S_192>       == 24, "S_192");
+static_assert(key_size_v<S_256>       == 32, "S_256");
+static_assert(key_size_v<E_SECP192R1> == 24, "E_SECP192R1");
+static_assert(key_size_v<E_SECP224R1> == 28, "E_SECP224R1");
+static_assert(key_size_v<E_SECP256R1> == 32, "E_SECP256R1");
+static_assert(key_size_v<E_SECP384R1> == 48, "E_SECP384R1");
+static_assert(key_size_v<E_SECP521R1> == 66, "E_SECP521R1");
+
+/*! \brief Size in bytes of the key code of a key of \ref key_length bytes.
+*/
+constexpr std::size_t key_code_size(const std::size_t key_length) noexcept
+{
+    return BK_KEY_CODE_HEADER_SIZE_BYTES + key_length;
+}
+
+/*! \brief Fixed-size byte buffer for key material.
+
+    \details Its storage is inside the object, 32-bit aligned, and is zeroized by the
+             destructor. Copying is not allowed. Moving copies the bytes and zeroizes
+             the source.
+*/
+template <std::size_t Size>
+class secure_array {
+public:
+    secure_array() noexcept : data_{} {}
+
+    secure_array(const secure_array &) = delete;
+    secure_array & operator=(const secure_array &) = delete;
+
+    secure_array(secure_array && other) noexcept
+    {
+        for (std::size_t i = 0; i < Size; i++)
+        {
+            data_[i] = other.data_[i];
+        }
+        other.clear();
+    }
+
+    secure_array & operator=(secure_array && other) noexcept
+    {
+        if (this != &other)
+        {
+            for (std::size_t i = 0; i < Size; i++)
+            {
+                data_[i] = other.data_[i];
+            }
+            other.clear();
+        }
+        return *this;
+    }
+
+    ~secure_array() { clear(); }
+
+    /*! \brief Zeroize the content. */
+    void clear() noexcept { detail::wipe(data_, Size); }
+
+    std::uint8_t       * data() noexcept       { return data_; }
+    const std::uint8_t * data() const noexcept { return data_; }
+    static constexpr std::size_t size() noexcept { return Size; }
+
+    std::uint8_t       & operator[](const std::size_t i) noexcept       { return data_[i]; }
+    const std::uint8_t & operator[](const std::size_t i) const noexcept { return data_[i]; }
+
+    std::uint8_t       * begin() noexcept       { return data_; }
+    const std::uint8_t * begin() const noexcept { return data_; }
+    std::uint8_t       * end() noexcept         { return data_ + Size; }
+    const std::uint8_t * end() const noexcept   { return data_ + Size; }
+
+private:
+    alignas(WORD_BYTE) std::uint8_t data_[Size];
+};
+
+/*! \brief Key of type \ref Type, as returned by \ref get_key.
+*/
+template <key_type_t Type>
+using key = secure_array<key_size_v<Type>>;
+
+#if defined(__cpp_lib_span)
+template <class T>
+using span = std::span<T>;
+#else
+/*! \brief Contiguous view over a byte range, standing in for std::span before C++20.
+*/
+template <class T>
+class span {
+public:
+    constexpr span() noexcept : data_(nullptr), size_(0) {}
+
+    constexpr span(T * const data, const std::size_t size) noexcept : data_(data), size_(size) {}
+
+    template <std::size_t N>
+    constexpr span(T (&array)[N]) noexcept : data_(array), size_(N) {}
+
+    /* Any container with data() and size(), such as std::vector, std::array,
+       std::string, secure_array or another span. */
+    template <class C,
+              class = std::enable_if_t<
+                  !std::is_array<std::remove_reference_t<C>>::value
+                  && std::is_convertible<decltype(std::declval<C &>().data()), T *>::value>>
+    constexpr span(C && container) noexcept : data_(container.data()), size_(container.size()) {}
+
+    constexpr T         * data() const noexcept  { return data_; }
+    constexpr std::size_t size() const noexcept  { return size_; }
+    constexpr bool        empty() const noexcept { return size_ == 0; }
+    constexpr T         * begin() const noexcept { return data_; }
+    constexpr T         * end() const noexcept   { return data_ + size_; }
+    constexpr T         & operator[](const std::size_t i) const noexcept { return data_[i]; }
+
+private:
+    T           * data_;
+    std::size_t   size_;
+};
+#endif
+
+/*! \brief Index and length of an unwrapped key, see \ref unwrap.
+*/
+struct unwrap_result {
+    std::uint16_t key_length; /*!< Length in bytes of the unwrapped key. */
+    std::uint8_t  index;      /*!< Index associated to the key. */
+};
+
+
+/****************************************************************************
+*                      P U B L I C  I N T E R F A C E                       *
+*****************************************************************************/
+/*! \brief Get a device-specific key. See \ref bk_get_key.
+
+    \details The result is sized for \ref Type at compile time.
+
+    \param[in] index Value between 0 and 255 specifying the index associated to the key.
+
+    \returns The key. Throws \ref error on failure.
+*/
+template <key_type_t Type>
+key<Type> get_key(const std::uint8_t index)
+{
+    key<Type> result;
+
+    detail::check(bk_get_key(Type, index, result.data()));
+    return result;
+}
+
+
+/*! \brief Wrap a key into a key code. See \ref bk_wrap.
+
+    \param[in] index Value between 0 and 255 specifying the index associated to the key.
+
+    \param[in] key The key, 32-bit aligned. Its size must be in [4, 1024] and a multiple of 4.
+
+    \param[out] key_code Buffer for the key code, 32-bit aligned. It must hold at least
+                         \ref key_code_size(key.size()) bytes.
+
+    \returns The number of bytes written to \ref key_code. Throws \ref error on failure.
+*/
+inline std::size_t wrap(const std::uint8_t             index,
+                        const span<const std::uint8_t> key,
+                        const span<std::uint8_t>       key_code)
+{
+    if ((key.size() > 1024) || (key_code.size() < key_code_size(key.size())))
+    {
+        throw error(IID_INVALID_PARAMETERS);
+    }
+    detail::check(bk_wrap(index, key.data(), static_cast<std::uint16_t>(key.size()),
+                          key_code.data()));
+    return key_code_size(key.size());
+}
+
+
+/*! \brief Unwrap a key code. See \ref bk_unwrap.
+
+    \param[in] key_code The key code generated by \ref wrap, 32-bit aligned.
+
+    \param[out] key Buffer for the key, 32-bit aligned. It must hold at least
+                    key_code.size() - \ref BK_KEY_CODE_HEADER_SIZE_BYTES bytes.
+
+    \returns The length and index of the key. Throws \ref error on failure, including
+             \ref IID_INVALID_KEY_CODE when the key code fails authentication.
+*/
+inline unwrap_result unwrap(const span<const std::uint8_t> key_code,
+                            const span<std::uint8_t>       key)
+{
+    unwrap_result result;
+
+    if ((key_code.size() <= BK_KEY_CODE_HEADER_SIZE_BYTES)
+        || (key.size() < key_code.size() - BK_KEY_CODE_HEADER_SIZE_BYTES))
+    {
+        throw error(IID_INVALID_PARAMETERS);
+    }
+    detail::check(bk_unwrap(key_code.data(), key.data(), &result.key_length, &result.index));
+    return result;
+}
+
+
+/*! \brief Tag selecting enrollment in the \ref session constructor.
+*/
+struct enroll_t {
+    explicit enroll_t() = default;
+};
+inline constexpr enroll_t enroll{};
+
+/*! \brief Scope in which Broadkey is started.
+
+    \details The constructor calls \ref bk_init and then \ref bk_start or \ref bk_enroll.
+             The destructor calls \ref bk_stop. Only one session may exist at a time.
+             Sessions can be neither copied nor moved.
+*/
+class session {
+public:
+    /*! \brief Start from an activation code. See \ref bk_start.
+
+        \param[in] sram_puf The SRAM PUF memory, 32-bit aligned, of at least
+                            \ref BK_SRAM_SIZE_BYTES.
+
+        \param[in] activation_code The activation code, 32-bit aligned, of
+                                   \ref BK_AC_SIZE_BYTES.
+    */
+    session(const span<std::uint8_t>       sram_puf,
+            const span<const std::uint8_t> activation_code)
+    {
+        if (activation_code.size() < BK_AC_SIZE_BYTES)
+        {
+            throw error(IID_INVALID_PARAMETERS);
+        }
+        init(sram_puf);
+        check_or_stop(bk_start(activation_code.data()));
+    }
+
+    /*! \brief Enroll and generate an activation code. See \ref bk_enroll.
+
+        \param[in] sram_puf The SRAM PUF memory, 32-bit aligned, of at least
+                            \ref BK_SRAM_SIZE_BYTES.
+
+        \param[out] activation_code Buffer for the activation code, 32-bit aligned,
+                                    of at least \ref BK_AC_SIZE_BYTES.
+    */
+    session(const span<std::uint8_t> sram_puf,
+            enroll_t,
+            const span<std::uint8_t> activation_code)
+    {
+        if (activation_code.size() < BK_AC_SIZE_BYTES)
+        {
+            throw error(IID_INVALID_PARAMETERS);
+        }
+        init(sram_puf);
+        check_or_stop(bk_enroll(activation_code.data()));
+    }
+
+    session(const session &) = delete;
+    session & operator=(const session &) = delete;
+
+    ~session() { (void)bk_stop(); }
+
+private:
+    static void init(const span<std::uint8_t> sram_puf)
+    {
+        if (sram_puf.size() > UINT16_MAX)
+        {
+            throw error(IID_INVALID_PARAMETERS);
+        }
+        detail::check(bk_init(sram_puf.data(), static_cast<std::uint16_t>(sram_puf.size())));
+    }
+
+    /* The destructor does not run when a constructor throws, so a failed start
+       or enrollment undoes bk_init here. */
+    static void check_or_stop(const iid_return_t rc)
+    {
+        if (rc != IID_SUCCESS)
+        {
+            (void)bk_stop();
+            throw error(rc);
+        }
+    }
+};
+
+} // namespace bk
+
+#endif /* __IID_BROADKEY__HPP__ */
@@ -0,0 +1,427 @@
+/*
+Copyright (c) 2017, prpl Foundation
+Permission to use, copy, modify, and/or distribute this software for any purpose with or without
+fee is hereby granted, provided that the above copyright notice and this permission notice appear
+in all copies.
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE
+INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE
+FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION,
+ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+#define _DEFAULT_SOURCE
+
+#include <stdlib.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "iidbroadkey_arena.h"
+#include "iidreturn_codes.h"
+
+/************************************************************************
+*                        D E F I N I T I O N S                          *
+*************************************************************************/
+/* Blocks held by one thread per size class, and the number moved at once
+   between a thread cache and the shared free list. */
+#define ARENA_CACHE_SIZE               32
+#define ARENA_CACHE_BATCH              16
+
+static const uint32_t arena_class_sizes[BK_ARENA_CLASS_COUNT] = {
+    16, 32, 48, 80, 128, 256, 576, 1088
+};
+
+/* Free blocks of one size class shared by all threads, as a stack of block
+   numbers. The blocks themselves are never written while free, so a freed
+   block stays all zero. */
+typedef struct arena_class {
+    pthread_mutex_t      lock;
+    uint8_t            * base;
+    uint32_t             block_size;
+    uint32_t             capacity;
+    uint32_t             free_count;
+    uint32_t           * free_blocks;
+} arena_class_t;
+
+typedef struct arena_cache {
+    struct arena_cache * next;
+    bk_arena_t         * arena;
+    bool                 in_use;
+    uint32_t             count[BK_ARENA_CLASS_COUNT];
+    uint8_t            * blocks[BK_ARENA_CLASS_COUNT][ARENA_CACHE_SIZE];
+} arena_cache_t;
+
+struct bk_arena {
+    uint8_t            * memory;
+    size_t               size;
+    pthread_key_t        cache_key;
+    pthread_mutex_t      cache_lock;
+    arena_cache_t      * caches;
+    arena_class_t        classes[BK_ARENA_CLASS_COUNT];
+};
+
+
+/****************************************************************************
+*                     P R I V A T E  F U N C T I O N S                      *
+*****************************************************************************/
+static void arena_wipe(      void   * const buffer,
+                       const size_t         size)
+{
+    volatile uint8_t * p = (volatile uint8_t *)buffer;
+    size_t             i;
+
+    for (i = 0; i < size; i++)
+    {
+        p[i] = 0;
+    }
+}
+
+static uint32_t arena_class_of_size(const size_t size)
+{
+    uint32_t c;
+
+    for (c = 0; c < BK_ARENA_CLASS_COUNT - 1; c++)
+    {
+        if (size <= arena_class_sizes[c])
+        {
+            break;
+        }
+    }
+
+    return c;
+}
+
+static bool arena_class_of_block(const bk_arena_t * const arena,
+                                 const uint8_t    * const block,
+                                       uint32_t   * const class_index)
+{
+    const arena_class_t * class;
+    uintptr_t             offset;
+    uint32_t              c;
+
+    for (c = 0; c < BK_ARENA_CLASS_COUNT; c++)
+    {
+        class = &arena->classes[c];
+        if ((uintptr_t)block < (uintptr_t)class->base)
+        {
+            continue;
+        }
+        offset = (uintptr_t)block - (uintptr_t)class->base;
+        if (offset < (uintptr_t)class->capacity * class->block_size)
+        {
+            *class_index = c;
+            return (offset % class->block_size) == 0;
+        }
+    }
+
+    return false;
+}
+
+/* Move up to ARENA_CACHE_BATCH free blocks from the shared list to the cache. */
+static void arena_refill(bk_arena_t    * const arena,
+                         arena_cache_t * const cache,
+                         const uint32_t        c)
+{
+    arena_class_t * const class = &arena->classes[c];
+    uint32_t              n;
+
+    (void)pthread_mutex_lock(&class->lock);
+    n = (class->free_count < ARENA_CACHE_BATCH) ? class->free_count : ARENA_CACHE_BATCH;
+    while (n-- != 0)
+    {
+        class->free_count--;
+        cache->blocks[c][cache->count[c]++] =
+            class->base + (size_t)class->free_blocks[class->free_count] * class->block_size;
+    }
+    (void)pthread_mutex_unlock(&class->lock);
+}
+
+/* Return the \ref count most recently cached blocks of class \ref c to the shared list. */
+static void arena_flush(bk_arena_t    * const arena,
+                        arena_cache_t * const cache,
+                        const uint32_t        c,
+                        const uint32_t        count)
+{
+    arena_class_t * const class = &arena->classes[c];
+    uint32_t              n;
+
+    (void)pthread_mutex_lock(&class->lock);
+    for (n = 0; n < count; n++)
+    {
+        cache->count[c]--;
+        class->free_blocks[class->free_count++] =
+            (uint32_t)((size_t)(cache->blocks[c][cache->count[c]] - class->base) / class->block_size);
+    }
+    (void)pthread_mutex_unlock(&class->lock);
+}
+
+/* Thread exit: hand the cached blocks back and make the cache reusable. */
+static void arena_cache_release(void * const value)
+{
+    arena_cache_t * const cache = (arena_cache_t *)value;
+    bk_arena_t    * const arena = cache->arena;
+    uint32_t              c;
+
+    for (c = 0; c < BK_ARENA_CLASS_COUNT; c++)
+    {
+        arena_flush(arena, cache, c, cache->count[c]);
+    }
+
+    (void)pthread_mutex_lock(&arena->cache_lock);
+    cache->in_use = false;
+    (void)pthread_mutex_unlock(&arena->cache_lock);
+}
+
+static arena_cache_t * arena_get_cache(bk_arena_t * const arena)
+{
+    arena_cache_t * cache = (arena_cache_t *)pthread_getspecific(arena->cache_key);
+
+    if (cache != NULL)
+    {
+        return cache;
+    }
+
+    /* First use by this thread: take the cache of a thread that exited, or
+       a new one. The arena keeps every cache so that it can free them. */
+    (void)pthread_mutex_lock(&arena->cache_lock);
+    for (cache = arena->caches; cache != NULL; cache = cache->next)
+    {
+        if (!cache->in_use)
+        {
+            break;
+        }
+    }
+    if (cache == NULL)
+    {
+        cache = (arena_cache_t *)calloc(1, sizeof(arena_cache_t));
+        if (cache != NULL)
+        {
+            cache->arena   = arena;
+            cache->next    = arena->caches;
+            arena->caches  = cache;
+        }
+    }
+    if (cache != NULL)
+    {
+        cache->in_use = true;
+    }
+    (void)pthread_mutex_unlock(&arena->cache_lock);
+
+    if ((cache != NULL) && (pthread_setspecific(arena->cache_key, cache) != 0))
+    {
+        (void)pthread_mutex_lock(&arena->cache_lock);
+        cache->in_use = false;
+        (void)pthread_mutex_unlock(&arena->cache_lock);
+        cache = NULL;
+    }
+
+    return cache;
+}
+
+static void arena_release_memory(bk_arena_t * const arena)
+{
+    uint32_t c;
+
+    for (c = 0; c < BK_ARENA_CLASS_COUNT; c++)
+    {
+        free(arena->classes[c].free_blocks);
+    }
+    if (arena->memory != NULL)
+    {
+        (void)munmap(arena->memory, arena->size);
+    }
+    free(arena);
+}
+
+
+/****************************************************************************
+*                      P U B L I C  F U N C T I O N S                       *
+*****************************************************************************/
+iid_return_t bk_arena_create(const uint32_t             blocks_per_class,
+                                   bk_arena_t ** const  arena)
+{
+    bk_arena_t * result;
+    size_t       page_size;
+    size_t       offset;
+    uint32_t     c;
+    uint32_t     i;
+
+    if ((arena == NULL) || (blocks_per_class == 0))
+    {
+        return IID_INVALID_PARAMETERS;
+    }
+
+    result = (bk_arena_t *)calloc(1, sizeof(bk_arena_t));
+    if (result == NULL)
+    {
+        return IID_ERROR_RESOURCES;
+    }
+
+    page_size = (size_t)sysconf(_SC_PAGESIZE);
+    result->size = 0;
+    for (c = 0; c < BK_ARENA_CLASS_COUNT; c++)
+    {
+        if ((size_t)blocks_per_class > (SIZE_MAX / 2) / BK_ARENA_CLASS_COUNT / arena_class_sizes[c])
+        {
+            free(result);
+            return IID_INVALID_PARAMETERS;
+        }
+        result->size += (size_t)blocks_per_class * arena_class_sizes[c];
+        result->classes[c].free_blocks = (uint32_t *)malloc((size_t)blocks_per_class * sizeof(uint32_t));
+        if (result->classes[c].free_blocks == NULL)
+        {
+            arena_release_memory(result);
+            return IID_ERROR_RESOURCES;
+        }
+    }
+    result->size = (result->size + page_size - 1) & ~(page_size - 1);
+
+    result->memory = (uint8_t *)mmap(NULL, result->size, PROT_READ | PROT_WRITE,
+                                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (result->memory == (uint8_t *)MAP_FAILED)
+    {
+        result->memory = NULL;
+        arena_release_memory(result);
+        return IID_ERROR_RESOURCES;
+    }
+    if (mlock(result->memory, result->size) != 0)
+    {
+        arena_release_memory(result);
+        return IID_ERROR_RESOURCES;
+    }
+#ifdef MADV_DONTDUMP
+    (void)madvise(result->memory, result->size, MADV_DONTDUMP);
+#endif
+#ifdef MADV_WIPEONFORK
+    (void)madvise(result->memory, result->size, MADV_WIPEONFORK);
+#endif
+
+    if (pthread_key_create(&result->cache_key, arena_cache_release) != 0)
+    {
+        (void)munlock(result->memory, result->size);
+        arena_release_memory(result);
+        return IID_ERROR_RESOURCES;
+    }
+    (void)pthread_mutex_init(&result->cache_lock, NULL);
+
+    /* Every block size is a multiple of 16 and the mapping is page aligned,
+       so every block is 16-byte aligned. */
+    offset = 0;
+    for (c = 0; c < BK_ARENA_CLASS_COUNT; c++)
+    {
+        arena_class_t * const class = &result->classes[c];
+
+        (void)pthread_mutex_init(&class->lock, NULL);
+        class->base       = result->memory + offset;
+        class->block_size = arena_class_sizes[c];
+        class->capacity   = blocks_per_class;
+        class->free_count = blocks_per_class;
+        for (i = 0; i < blocks_per_class; i++)
+        {
+            /* Lowest addresses are handed out first. */
+            class->free_blocks[i] = blocks_per_class - 1 - i;
+        }
+        offset += (size_t)blocks_per_class * class->block_size;
+    }
+
+    *arena = result;
+
+    return IID_SUCCESS;
+}
+
+iid_return_t bk_arena_alloc(      bk_arena_t *  const arena,
+                            const size_t              size,
+                                  uint8_t    ** const buffer)
+{
+    arena_cache_t * cache;
+    uint32_t        c;
+
+    if ((arena == NULL) || (buffer == NULL) || (size == 0) || (size > BK_ARENA_MAX_ALLOC_BYTES))
+    {
+        return IID_INVALID_PARAMETERS;
+    }
+
+    cache = arena_get_cache(arena);
+    if (cache == NULL)
+    {
+        return IID_ERROR_RESOURCES;
+    }
+
+    c = arena_class_of_size(size);
+    if (cache->count[c] == 0)
+    {
+        arena_refill(arena, cache, c);
+        if (cache->count[c] == 0)
+        {
+            return IID_ERROR_RESOURCES;
+        }
+    }
+    *buffer = cache->blocks[c][--cache->count[c]];
+
+    return IID_SUCCESS;
+}
+
+iid_return_t bk_arena_free(bk_arena_t * const arena,
+                           uint8_t    * const buffer)
+{
+    arena_cache_t * cache;
+    uint32_t        c;
+
+    if ((arena == NULL) || (buffer == NULL) || !arena_class_of_block(arena, buffer, &c))
+    {
+        return IID_INVALID_PARAMETERS;
+    }
+
+    arena_wipe(buffer, arena->classes[c].block_size);
+
+    cache = arena_get_cache(arena);
+    if (cache == NULL)
+    {
+        /* No cache for this thread: return the block to the shared list. */
+        arena_class_t * const class = &arena->classes[c];
+
+        (void)pthread_mutex_lock(&class->lock);
+        class->free_blocks[class->free_count++] =
+            (uint32_t)((size_t)(buffer - class->base) / class->block_size);
+        (void)pthread_mutex_unlock(&class->lock);
+        return IID_SUCCESS;
+    }
+
+    if (cache->count[c] == ARENA_CACHE_SIZE)
+    {
+        arena_flush(arena, cache, c, ARENA_CACHE_BATCH);
+    }
+    cache->blocks[c][cache->count[c]++] = buffer;
+
+    return IID_SUCCESS;
+}
+
+iid_return_t bk_arena_destroy(bk_arena_t * const arena)
+{
+    arena_cache_t * cache;
+    arena_cache_t * next;
+    uint32_t        c;
+
+    if (arena == NULL)
+    {
+        return IID_INVALID_PARAMETERS;
+    }
+
+    (void)pthread_key_delete(arena->cache_key);
+    for (cache = arena->caches; cache != NULL; cache = next)
+    {
+        next = cache->next;
+        free(cache);
+    }
+    for (c = 0; c < BK_ARENA_CLASS_COUNT; c++)
+    {
+        (void)pthread_mutex_destroy(&arena->classes[c].lock);
+    }
+    (void)pthread_mutex_destroy(&arena->cache_lock);
+
+    arena_wipe(arena->memory, arena->size);
+    (void)munlock(arena->memory, arena->size);
+    arena_release_memory(arena);
+
+    return IID_SUCCESS;
+}
@@ -0,0 +1,121 @@
+/*
+Copyright (c) 2017, prpl Foundation
+Permission to use, copy, modify, and/or distribute this software for any purpose with or without
+fee is hereby granted, provided that the above copyright notice and this permission notice appear
+in all copies.
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE
+INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE
+FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION,
+ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+#ifndef __IID_BROADKEY_ARENA__H__
+#define __IID_BROADKEY_ARENA__H__
+
+#include "iidbroadkey.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/************************************************************************
+*                        D E F I N I T I O N S                          *
+*************************************************************************/
+/* Secure arena for key and key code buffers.
+
+   The arena is one anonymous mapping, locked in memory and excluded from
+   core dumps where the system supports it. It is carved into fixed-size
+   blocks of the size classes below. The classes cover every key size of
+   bk_get_key and every key code of bk_wrap, up to a 1024-byte key. Every
+   block is 32-bit aligned, as required by bk_wrap and bk_unwrap.
+
+   Each thread keeps a small cache of free blocks per class, so that most
+   allocations and frees take no lock. Blocks are zeroized when freed. */
+
+/*! \brief Largest buffer the arena can allocate: a key code of a 1024-byte key.
+*/
+#define BK_ARENA_MAX_ALLOC_BYTES       (BK_KEY_CODE_HEADER_SIZE_BYTES + 1024)
+
+/*! \brief Number of size classes: 16, 32, 48, 80, 128, 256, 576 and 1088 bytes.
+*/
+#define BK_ARENA_CLASS_COUNT           8
+
+/*! \brief Opaque secure arena.
+*/
+typedef struct bk_arena bk_arena_t;
+
+
+/****************************************************************************
+*                      P U B L I C  I N T E R F A C E                       *
+*****************************************************************************/
+/*! \brief Create a secure arena.
+
+    \details The memory of the arena is reserved and locked here, so it counts against
+             RLIMIT_MEMLOCK for the whole life of the arena.
+
+    \param[in] blocks_per_class Number of blocks of each size class. Must be at least 1.
+
+    \param[out] **arena Pointer to a buffer which will hold the arena.
+
+    \returns \ref IID_SUCCESS if success, \ref IID_ERROR_RESOURCES if the memory could not
+             be mapped or locked, otherwise another return code.
+*/
+iid_return_t bk_arena_create(const uint32_t             blocks_per_class,
+                                   bk_arena_t ** const  arena);
+
+
+/*! \brief Allocate a buffer from a secure arena.
+
+    \details Returns a block of the smallest size class that holds \ref size bytes.
+             The block is 32-bit aligned and zero-filled.
+             It can be called concurrently from several threads.
+
+    \param[in] *arena The arena.
+
+    \param[in] size Size in bytes of the buffer, in [1, \ref BK_ARENA_MAX_ALLOC_BYTES].
+
+    \param[out] **buffer Pointer to a buffer which will hold the address of the block.
+
+    \returns \ref IID_SUCCESS if success, \ref IID_ERROR_RESOURCES if every block of the
+             size class is in use, otherwise another return code.
+*/
+iid_return_t bk_arena_alloc(      bk_arena_t *  const arena,
+                            const size_t              size,
+                                  uint8_t    ** const buffer);
+
+
+/*! \brief Zeroize and free a buffer allocated by \ref bk_arena_alloc.
+
+    \details The whole block is zeroized before it can be reused. The buffer may be
+             freed from another thread than the one that allocated it. It must
+             not be freed twice.
+             It can be called concurrently from several threads.
+
+    \param[in] *arena The arena the buffer was allocated from.
+
+    \param[in] *buffer The buffer.
+
+    \returns \ref IID_SUCCESS if success, \ref IID_INVALID_PARAMETERS if \ref buffer is
+             not a block of \ref arena, otherwise another return code.
+*/
+iid_return_t bk_arena_free(bk_arena_t * const arena,
+                           uint8_t    * const buffer);
+
+
+/*! \brief Destroy a secure arena.
+
+    \details Zeroizes, unlocks and unmaps all its memory, including blocks that were not
+             freed. No other thread may use the arena during or after this call.
+
+    \param[in] *arena The arena.
+
+    \returns \ref IID_SUCCESS if success, otherwise another return code.
+*/
+iid_return_t bk_arena_destroy(bk_arena_t * const arena);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __IID_BROADKEY_ARENA__H__ */
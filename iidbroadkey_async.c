@@ -0,0 +1,392 @@
+/*
+Copyright (c) 2017, prpl Foundation
+Permission to use, copy, modify, and/or distribute this software for any purpose with or without
+fee is hereby granted, provided that the above copyright notice and this permission notice appear
+in all copies.
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE
+INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE
+FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION,
+ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+#include <stdlib.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <sys/eventfd.h>
+#define ASYNC_HAS_EVENTFD              1
+#else
+#define ASYNC_HAS_EVENTFD              0
+#endif
+
+#include "iidbroadkey_async.h"
+#include "iidreturn_codes.h"
+
+/************************************************************************
+*                        D E F I N I T I O N S                          *
+*************************************************************************/
+typedef struct async_ring {
+    bk_async_request_t ** slots;
+    uint32_t              head;
+    uint32_t              count;
+} async_ring_t;
+
+struct bk_async_queue {
+    bk_ctx_t            * ctx;
+    uint32_t              depth;
+    uint32_t              in_flight;
+    bool                  stopping;
+    async_ring_t          submissions;
+    async_ring_t          completions;
+    pthread_mutex_t       submission_lock;
+    pthread_cond_t        submission_ready;
+    pthread_mutex_t       completion_lock;
+    int                   event_fd;
+    uint16_t              worker_count;
+    pthread_t           * workers;
+};
+
+
+/****************************************************************************
+*                     P R I V A T E  F U N C T I O N S                      *
+*****************************************************************************/
+static void async_push(      async_ring_t       * const ring,
+                       const uint32_t                   depth,
+                             bk_async_request_t * const request)
+{
+    ring->slots[(ring->head + ring->count) % depth] = request;
+    ring->count++;
+}
+
+static bk_async_request_t * async_pop(      async_ring_t * const ring,
+                                      const uint32_t             depth)
+{
+    bk_async_request_t * const request = ring->slots[ring->head];
+
+    ring->head = (ring->head + 1) % depth;
+    ring->count--;
+
+    return request;
+}
+
+/* Processes requests through one batch call per operation. Only the
+   descriptors are copied, key material stays in the caller's buffers. */
+static void async_process(      bk_ctx_t           *  const ctx,
+                                bk_async_request_t ** const requests,
+                          const uint16_t                  count)
+{
+    bk_key_request_t    get_key[BK_ASYNC_BATCH_SIZE];
+    bk_wrap_request_t   wrap[BK_ASYNC_BATCH_SIZE];
+    bk_unwrap_request_t unwrap[BK_ASYNC_BATCH_SIZE];
+    uint16_t            get_key_count = 0;
+    uint16_t            wrap_count    = 0;
+    uint16_t            unwrap_count  = 0;
+    uint16_t            i;
+
+    for (i = 0; i < count; i++)
+    {
+        switch (requests[i]->op)
+        {
+            case BK_ASYNC_GET_KEY:
+                get_key[get_key_count++] = requests[i]->u.get_key;
+                break;
+            case BK_ASYNC_WRAP:
+                wrap[wrap_count++] = requests[i]->u.wrap;
+                break;
+            case BK_ASYNC_UNWRAP:
+                unwrap[unwrap_count++] = requests[i]->u.unwrap;
+                break;
+            default:
+                break;
+        }
+    }
+
+    if (get_key_count != 0)
+    {
+        (void)bk_ctx_get_key_batch(ctx, get_key, get_key_count);
+    }
+    if (wrap_count != 0)
+    {
+        (void)bk_ctx_wrap_batch(ctx, wrap, wrap_count);
+    }
+    if (unwrap_count != 0)
+    {
+        (void)bk_ctx_unwrap_batch(ctx, unwrap, unwrap_count);
+    }
+
+    get_key_count = 0;
+    wrap_count    = 0;
+    unwrap_count  = 0;
+
+    for (i = 0; i < count; i++)
+    {
+        switch (requests[i]->op)
+        {
+            case BK_ASYNC_GET_KEY:
+                requests[i]->u.get_key = get_key[get_key_count++];
+                requests[i]->status    = requests[i]->u.get_key.status;
+                break;
+            case BK_ASYNC_WRAP:
+                requests[i]->u.wrap = wrap[wrap_count++];
+                requests[i]->status = requests[i]->u.wrap.status;
+                break;
+            case BK_ASYNC_UNWRAP:
+                requests[i]->u.unwrap = unwrap[unwrap_count++];
+                requests[i]->status   = requests[i]->u.unwrap.status;
+                break;
+            default:
+                /* Rejected by bk_async_submit, the descriptor is left untouched. */
+                requests[i]->status = IID_INVALID_PARAMETERS;
+                break;
+        }
+    }
+}
+
+static void * async_worker(void * const arg)
+{
+    bk_async_queue_t * const queue = (bk_async_queue_t *)arg;
+    bk_async_request_t     * batch[BK_ASYNC_BATCH_SIZE];
+    uint16_t                 count;
+    uint16_t                 i;
+    bool                     notify;
+#if ASYNC_HAS_EVENTFD == 1
+    const uint64_t           one = 1;
+#endif
+
+    for (;;)
+    {
+        pthread_mutex_lock(&queue->submission_lock);
+        while ((queue->submissions.count == 0) && !queue->stopping)
+        {
+            pthread_cond_wait(&queue->submission_ready, &queue->submission_lock);
+        }
+        if (queue->submissions.count == 0)
+        {
+            pthread_mutex_unlock(&queue->submission_lock);
+            break;
+        }
+        count = 0;
+        while ((count < BK_ASYNC_BATCH_SIZE) && (queue->submissions.count != 0))
+        {
+            batch[count++] = async_pop(&queue->submissions, queue->depth);
+        }
+        pthread_mutex_unlock(&queue->submission_lock);
+
+        async_process(queue->ctx, batch, count);
+
+        pthread_mutex_lock(&queue->completion_lock);
+        notify = (queue->completions.count == 0);
+        for (i = 0; i < count; i++)
+        {
+            async_push(&queue->completions, queue->depth, batch[i]);
+        }
+        pthread_mutex_unlock(&queue->completion_lock);
+
+#if ASYNC_HAS_EVENTFD == 1
+        if (notify)
+        {
+            (void)write(queue->event_fd, &one, sizeof(one));
+        }
+#else
+        (void)notify;
+#endif
+    }
+
+    return NULL;
+}
+
+static void async_free(bk_async_queue_t * const queue)
+{
+    if (queue->event_fd >= 0)
+    {
+        close(queue->event_fd);
+    }
+    free(queue->workers);
+    free(queue->submissions.slots);
+    free(queue->completions.slots);
+    free(queue);
+}
+
+
+/****************************************************************************
+*                      P U B L I C  F U N C T I O N S                       *
+*****************************************************************************/
+iid_return_t bk_async_create(      bk_ctx_t          *  const ctx,
+                             const uint32_t                 depth,
+                             const uint16_t                 workers,
+                                   bk_async_queue_t  ** const queue)
+{
+    bk_async_queue_t * created;
+    uint16_t           i;
+
+    if ((depth == 0) || (workers == 0) || (queue == NULL))
+    {
+        return IID_INVALID_PARAMETERS;
+    }
+
+    created = (bk_async_queue_t *)calloc(1, sizeof(*created));
+    if (created == NULL)
+    {
+        return IID_ERROR_RESOURCES;
+    }
+
+    created->ctx               = (ctx != NULL) ? ctx : bk_get_default_ctx();
+    created->depth             = depth;
+    created->event_fd          = -1;
+    created->submissions.slots = (bk_async_request_t **)calloc(depth, sizeof(bk_async_request_t *));
+    created->completions.slots = (bk_async_request_t **)calloc(depth, sizeof(bk_async_request_t *));
+    created->workers           = (pthread_t *)calloc(workers, sizeof(pthread_t));
+#if ASYNC_HAS_EVENTFD == 1
+    created->event_fd          = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+#endif
+
+    if ((created->submissions.slots == NULL) || (created->completions.slots == NULL) ||
+        (created->workers == NULL) || ((ASYNC_HAS_EVENTFD == 1) && (created->event_fd < 0)))
+    {
+        async_free(created);
+        return IID_ERROR_RESOURCES;
+    }
+
+    pthread_mutex_init(&created->submission_lock, NULL);
+    pthread_cond_init(&created->submission_ready, NULL);
+    pthread_mutex_init(&created->completion_lock, NULL);
+
+    for (i = 0; i < workers; i++)
+    {
+        if (pthread_create(&created->workers[i], NULL, async_worker, created) != 0)
+        {
+            break;
+        }
+        created->worker_count++;
+    }
+
+    if (created->worker_count != workers)
+    {
+        (void)bk_async_destroy(created);
+        return IID_ERROR_RESOURCES;
+    }
+
+    *queue = created;
+
+    return IID_SUCCESS;
+}
+
+iid_return_t bk_async_submit(      bk_async_queue_t   *  const queue,
+                                   bk_async_request_t ** const requests,
+                             const uint32_t                  count,
+                                   uint32_t           *  const submitted)
+{
+    uint32_t accepted = 0;
+    uint32_t i;
+
+    if ((queue == NULL) || ((requests == NULL) && (count != 0)) || (submitted == NULL))
+    {
+        return IID_INVALID_PARAMETERS;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        if ((requests[i] == NULL) ||
+            ((requests[i]->op != BK_ASYNC_GET_KEY) && (requests[i]->op != BK_ASYNC_WRAP) &&
+             (requests[i]->op != BK_ASYNC_UNWRAP)))
+        {
+            *submitted = 0;
+            return IID_INVALID_PARAMETERS;
+        }
+    }
+
+    pthread_mutex_lock(&queue->submission_lock);
+    while ((accepted < count) && (queue->in_flight < queue->depth))
+    {
+        async_push(&queue->submissions, queue->depth, requests[accepted]);
+        queue->in_flight++;
+        accepted++;
+    }
+    if (accepted != 0)
+    {
+        pthread_cond_broadcast(&queue->submission_ready);
+    }
+    pthread_mutex_unlock(&queue->submission_lock);
+
+    *submitted = accepted;
+
+    return IID_SUCCESS;
+}
+
+iid_return_t bk_async_reap(      bk_async_queue_t   *  const queue,
+                                 bk_async_request_t ** const requests,
+                           const uint32_t                  max_count,
+                                 uint32_t           *  const reaped)
+{
+    uint32_t count = 0;
+
+    if ((queue == NULL) || ((requests == NULL) && (max_count != 0)) || (reaped == NULL))
+    {
+        return IID_INVALID_PARAMETERS;
+    }
+
+    pthread_mutex_lock(&queue->completion_lock);
+    while ((count < max_count) && (queue->completions.count != 0))
+    {
+        requests[count++] = async_pop(&queue->completions, queue->depth);
+    }
+    pthread_mutex_unlock(&queue->completion_lock);
+
+    if (count != 0)
+    {
+        pthread_mutex_lock(&queue->submission_lock);
+        queue->in_flight -= count;
+        pthread_mutex_unlock(&queue->submission_lock);
+    }
+
+    *reaped = count;
+
+    return IID_SUCCESS;
+}
+
+iid_return_t bk_async_get_eventfd(bk_async_queue_t * const queue,
+                                  int              * const fd)
+{
+    if ((queue == NULL) || (fd == NULL))
+    {
+        return IID_INVALID_PARAMETERS;
+    }
+
+    if (queue->event_fd < 0)
+    {
+        return IID_NOT_ALLOWED;
+    }
+
+    *fd = queue->event_fd;
+
+    return IID_SUCCESS;
+}
+
+iid_return_t bk_async_destroy(bk_async_queue_t * const queue)
+{
+    uint16_t i;
+
+    if (queue == NULL)
+    {
+        return IID_INVALID_PARAMETERS;
+    }
+
+    pthread_mutex_lock(&queue->submission_lock);
+    queue->stopping = true;
+    pthread_cond_broadcast(&queue->submission_ready);
+    pthread_mutex_unlock(&queue->submission_lock);
+
+    for (i = 0; i < queue->worker_count; i++)
+    {
+        pthread_join(queue->workers[i], NULL);
+    }
+
+    pthread_mutex_destroy(&queue->submission_lock);
+    pthread_cond_destroy(&queue->submission_ready);
+    pthread_mutex_destroy(&queue->completion_lock);
+
+    async_free(queue);
+
+    return IID_SUCCESS;
+}
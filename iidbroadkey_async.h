@@ -0,0 +1,174 @@
+/*
+Copyright (c) 2017, prpl Foundation
+Permission to use, copy, modify, and/or distribute this software for any purpose with or without
+fee is hereby granted, provided that the above copyright notice and this permission notice appear
+in all copies.
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE
+INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE
+FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION,
+ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+#ifndef __IID_BROADKEY_ASYNC__H__
+#define __IID_BROADKEY_ASYNC__H__
+
+#include "iidbroadkey.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/************************************************************************
+*                        D E F I N I T I O N S                          *
+*************************************************************************/
+/*! \brief Maximum number of requests a worker hands to one batch call.
+*/
+#define BK_ASYNC_BATCH_SIZE            32
+
+/*! \brief Defines the operations of an asynchronous request.
+*/
+typedef enum bk_async_op {
+    BK_ASYNC_GET_KEY               = 0x00, /*!< \ref bk_get_key, described by get_key. */
+    BK_ASYNC_WRAP                  = 0x01, /*!< \ref bk_wrap, described by wrap. */
+    BK_ASYNC_UNWRAP                = 0x02  /*!< \ref bk_unwrap, described by unwrap. */
+} bk_async_op_t;
+
+/*! \brief Asynchronous request.
+
+    \details The request is owned by the caller and must stay valid, and unchanged,
+             from \ref bk_async_submit until it is returned by \ref bk_async_reap.
+             The results are written into the descriptor of the operation, as the
+             batch functions of iidbroadkey.h do. The return code of the operation
+             is written both into the status field of that descriptor and into
+             \ref status.
+*/
+typedef struct bk_async_request {
+    bk_async_op_t              op;         /*!< Operation to perform. */
+    iid_return_t               status;     /*!< Return code of the operation, set on completion. */
+    void                     * user_data;  /*!< Not used by the library. */
+    union {
+        bk_key_request_t       get_key;
+        bk_wrap_request_t      wrap;
+        bk_unwrap_request_t    unwrap;
+    } u;                                   /*!< Descriptor of the operation. */
+} bk_async_request_t;
+
+/*! \brief Opaque asynchronous queue.
+*/
+typedef struct bk_async_queue bk_async_queue_t;
+
+
+/****************************************************************************
+*                      P U B L I C  I N T E R F A C E                       *
+*****************************************************************************/
+/*! \brief Create an asynchronous queue.
+
+    \details Creates a submission ring and a completion ring of \ref depth entries
+             each, and a pool of worker threads that take requests from the submission
+             ring, process them through the batch functions of iidbroadkey.h on
+             \ref ctx and put them on the completion ring. All memory is allocated
+             here: submitting and reaping never allocate.
+             The context must be enrolled or started for the requests to succeed.
+
+    \param[in] *ctx Context used to process the requests, or NULL for the default context.
+
+    \param[in] depth Maximum number of requests in flight. Must be at least 1.
+
+    \param[in] workers Number of worker threads. Must be at least 1.
+
+    \param[out] **queue Pointer to a buffer which will hold the created queue.
+
+    \returns \ref IID_SUCCESS if success, \ref IID_ERROR_RESOURCES if memory or threads
+             could not be obtained, otherwise another return code.
+*/
+iid_return_t bk_async_create(      bk_ctx_t          *  const ctx,
+                             const uint32_t                 depth,
+                             const uint16_t                 workers,
+                                   bk_async_queue_t  ** const queue);
+
+
+/*! \brief Submit requests.
+
+    \details Adds requests to the submission ring without blocking. Requests are
+             accepted in order until \ref depth requests are in flight; a request is
+             in flight from its submission until it is reaped. The requests are
+             checked before any is accepted: if one of them is NULL or has an unknown
+             operation, none is submitted.
+
+    \param[in] *queue The queue.
+
+    \param[in] **requests Pointer to an array of \ref count request pointers.
+
+    \param[in] count Number of requests in \ref requests.
+
+    \param[out] *submitted Pointer to a buffer which will hold the number of requests
+                           accepted, the first ones of \ref requests.
+
+    \returns \ref IID_SUCCESS if success, \ref IID_INVALID_PARAMETERS if an entry of
+             \ref requests is NULL or has an unknown operation, otherwise another
+             return code.
+*/
+iid_return_t bk_async_submit(      bk_async_queue_t   *  const queue,
+                                   bk_async_request_t ** const requests,
+                             const uint32_t                  count,
+                                   uint32_t           *  const submitted);
+
+
+/*! \brief Reap completed requests.
+
+    \details Takes completed requests from the completion ring without blocking.
+             Requests may complete in another order than they were submitted.
+
+    \param[in] *queue The queue.
+
+    \param[out] **requests Pointer to an array of at least \ref max_count request pointers
+                           which will hold the completed requests.
+
+    \param[in] max_count Maximum number of requests to reap.
+
+    \param[out] *reaped Pointer to a buffer which will hold the number of requests reaped.
+
+    \returns \ref IID_SUCCESS if success, otherwise another return code.
+*/
+iid_return_t bk_async_reap(      bk_async_queue_t   *  const queue,
+                                 bk_async_request_t ** const requests,
+                           const uint32_t                  max_count,
+                                 uint32_t           *  const reaped);
+
+
+/*! \brief Get the completion notification file descriptor.
+
+    \details Returns an eventfd that becomes readable when the completion ring goes
+             from empty to non-empty, to be polled by an event loop. Read it to clear
+             the notification, then reap until \ref bk_async_reap returns no request.
+             The descriptor is owned by the queue.
+
+    \param[in] *queue The queue.
+
+    \param[out] *fd Pointer to a buffer which will hold the file descriptor.
+
+    \returns \ref IID_SUCCESS if success, \ref IID_NOT_ALLOWED if the platform has no
+             eventfd, otherwise another return code.
+*/
+iid_return_t bk_async_get_eventfd(bk_async_queue_t * const queue,
+                                  int              * const fd);
+
+
+/*! \brief Destroy an asynchronous queue.
+
+    \details Waits for the submitted requests to be processed, stops the workers and
+             releases all resources of the queue. Requests not reaped yet are dropped:
+             their results are complete but they are not returned anymore.
+
+    \param[in] *queue The queue.
+
+    \returns \ref IID_SUCCESS if success, otherwise another return code.
+*/
+iid_return_t bk_async_destroy(bk_async_queue_t * const queue);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __IID_BROADKEY_ASYNC__H__ */
@@ -0,0 +1,391 @@
+/*
+Copyright (c) 2017, prpl Foundation
+Permission to use, copy, modify, and/or distribute this software for any purpose with or without
+fee is hereby granted, provided that the above copyright notice and this permission notice appear
+in all copies.
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE
+INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE
+FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION,
+ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "iidbroadkey_client.h"
+#include "iidreturn_codes.h"
+
+/************************************************************************
+*                        D E F I N I T I O N S                          *
+*************************************************************************/
+/* Number of requests sent ahead of their responses by the batch calls. It
+   bounds the data queued in the socket in both directions. */
+#define CLIENT_PIPELINE_DEPTH          16
+
+struct bk_client {
+    int             fd;
+    pthread_mutex_t lock;
+    uint32_t        message[BK_SERVICE_MAX_MESSAGE_BYTES / WORD_BYTE];
+};
+
+typedef struct client_response {
+    iid_return_t    status;
+    uint8_t         index;
+    uint16_t        length;
+} client_response_t;
+
+
+/****************************************************************************
+*                     P R I V A T E  F U N C T I O N S                      *
+*****************************************************************************/
+static void client_wipe(      void   * const buffer,
+                        const size_t         size)
+{
+    volatile uint8_t * p = (volatile uint8_t *)buffer;
+    size_t             i;
+
+    for (i = 0; i < size; i++)
+    {
+        p[i] = 0;
+    }
+}
+
+/* Responses may still be in flight after an error, and the next call would
+   read one of them as its own: the connection is closed instead. Every later
+   call fails until the caller connects again. */
+static void client_fail(bk_client_t * const client)
+{
+    if (client->fd >= 0)
+    {
+        close(client->fd);
+        client->fd = -1;
+    }
+}
+
+static bool client_send(      bk_client_t * const client,
+                        const uint8_t             op,
+                        const uint8_t             index,
+                        const uint32_t            key_type,
+                        const uint8_t     * const payload,
+                        const uint16_t            length)
+{
+    uint8_t * const message = (uint8_t *)client->message;
+    ssize_t         sent;
+
+    if (client->fd < 0)
+    {
+        return false;
+    }
+
+    message[0] = op;
+    message[1] = index;
+    message[2] = (uint8_t)length;
+    message[3] = (uint8_t)(length >> 8);
+    message[4] = (uint8_t)key_type;
+    message[5] = (uint8_t)(key_type >> 8);
+    message[6] = (uint8_t)(key_type >> 16);
+    message[7] = (uint8_t)(key_type >> 24);
+    if (length != 0)
+    {
+        iid_memcpy(&message[BK_SERVICE_HEADER_SIZE_BYTES], payload, length);
+    }
+
+    sent = send(client->fd, message, BK_SERVICE_HEADER_SIZE_BYTES + (size_t)length, MSG_NOSIGNAL);
+    client_wipe(message, BK_SERVICE_HEADER_SIZE_BYTES + (size_t)length);
+
+    if (sent != (ssize_t)(BK_SERVICE_HEADER_SIZE_BYTES + (size_t)length))
+    {
+        client_fail(client);
+        return false;
+    }
+
+    return true;
+}
+
+/* Receives one response and copies its payload, at most max_length bytes,
+   to payload. */
+static bool client_receive(      bk_client_t       * const client,
+                                 client_response_t * const response,
+                                 uint8_t           * const payload,
+                           const uint16_t                  max_length)
+{
+    uint8_t * const message = (uint8_t *)client->message;
+    ssize_t         received;
+    bool            valid;
+
+    if (client->fd < 0)
+    {
+        return false;
+    }
+
+    received = recv(client->fd, message, sizeof(client->message), 0);
+    if (received < BK_SERVICE_HEADER_SIZE_BYTES)
+    {
+        if (received > 0)
+        {
+            client_wipe(message, (size_t)received);
+        }
+        client_fail(client);
+        return false;
+    }
+
+    response->status = message[0];
+    response->index  = message[1];
+    response->length = (uint16_t)(message[2] | (message[3] << 8));
+
+    valid = (response->length <= max_length) &&
+            (received == (ssize_t)(BK_SERVICE_HEADER_SIZE_BYTES + (size_t)response->length));
+    if (valid && (response->length != 0))
+    {
+        iid_memcpy(payload, &message[BK_SERVICE_HEADER_SIZE_BYTES], response->length);
+    }
+    client_wipe(message, (size_t)received);
+    if (!valid)
+    {
+        client_fail(client);
+    }
+
+    return valid;
+}
+
+
+/****************************************************************************
+*                      P U B L I C  F U N C T I O N S                       *
+*****************************************************************************/
+iid_return_t bk_client_connect(const char        *  const path,
+                                     bk_client_t ** const client)
+{
+    struct sockaddr_un address;
+    bk_client_t      * created;
+    const char       * socket_path = (path != NULL) ? path : BK_SERVICE_DEFAULT_PATH;
+
+    if ((client == NULL) || (strlen(socket_path) >= sizeof(address.sun_path)))
+    {
+        return IID_INVALID_PARAMETERS;
+    }
+
+    created = (bk_client_t *)calloc(1, sizeof(*created));
+    if (created == NULL)
+    {
+        return IID_ERROR_RESOURCES;
+    }
+
+    iid_memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    iid_memcpy(address.sun_path, socket_path, strlen(socket_path));
+
+    created->fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if ((created->fd < 0) ||
+        (connect(created->fd, (const struct sockaddr *)&address, sizeof(address)) != 0))
+    {
+        if (created->fd >= 0)
+        {
+            close(created->fd);
+        }
+        free(created);
+        return IID_ERROR_RESOURCES;
+    }
+
+    pthread_mutex_init(&created->lock, NULL);
+    *client = created;
+
+    return IID_SUCCESS;
+}
+
+iid_return_t bk_client_close(bk_client_t * const client)
+{
+    if (client == NULL)
+    {
+        return IID_INVALID_PARAMETERS;
+    }
+
+    client_fail(client);
+    pthread_mutex_destroy(&client->lock);
+    free(client);
+
+    return IID_SUCCESS;
+}
+
+iid_return_t bk_client_get_key(      bk_client_t * const client,
+                               const key_type_t          key_type,
+                               const uint8_t             index,
+                                     uint8_t     * const key)
+{
+    bk_key_request_t request;
+
+    request.key_type = key_type;
+    request.index    = index;
+    request.key      = key;
+
+    return bk_client_get_key_batch(client, &request, 1);
+}
+
+iid_return_t bk_client_get_key_batch(      bk_client_t      * const client,
+                                           bk_key_request_t * const requests,
+                                     const uint16_t                 count)
+{
+    client_response_t response;
+    uint16_t          sent     = 0;
+    uint16_t          received = 0;
+    iid_return_t      rc       = IID_SUCCESS;
+
+    if ((client == NULL) || (requests == NULL) || (count == 0))
+    {
+        return IID_INVALID_PARAMETERS;
+    }
+
+    pthread_mutex_lock(&client->lock);
+    while (received < count)
+    {
+        while ((sent < count) && ((sent - received) < CLIENT_PIPELINE_DEPTH))
+        {
+            if (!client_send(client, BK_SERVICE_GET_KEY, requests[sent].index,
+                             (uint32_t)requests[sent].key_type, NULL, 0))
+            {
+                break;
+            }
+            sent++;
+        }
+
+        if ((sent == received) ||
+            !client_receive(client, &response, requests[received].key,
+                            (uint16_t)BK_KEY_SIZE_BYTES(requests[received].key_type)))
+        {
+            /* The connection is closed: fail every request without a response. */
+            for (; received < count; received++)
+            {
+                requests[received].status = IID_ERROR_RESOURCES;
+            }
+            rc = (rc == IID_SUCCESS) ? IID_ERROR_RESOURCES : rc;
+            break;
+        }
+
+        requests[received].status = response.status;
+        if ((response.status != IID_SUCCESS) && (rc == IID_SUCCESS))
+        {
+            rc = response.status;
+        }
+        received++;
+    }
+    pthread_mutex_unlock(&client->lock);
+
+    return rc;
+}
+
+iid_return_t bk_client_wrap(      bk_client_t * const client,
+                            const uint8_t             index,
+                            const uint8_t     * const key,
+                            const uint16_t            key_length,
+                                  uint8_t     * const key_code)
+{
+    bk_wrap_request_t request;
+
+    request.index      = index;
+    request.key        = key;
+    request.key_length = key_length;
+    request.key_code   = key_code;
+
+    return bk_client_wrap_batch(client, &request, 1);
+}
+
+iid_return_t bk_client_wrap_batch(      bk_client_t       * const client,
+                                        bk_wrap_request_t * const requests,
+                                  const uint16_t                  count)
+{
+    client_response_t response;
+    uint16_t          sent     = 0;
+    uint16_t          received = 0;
+    uint16_t          i;
+    iid_return_t      rc       = IID_SUCCESS;
+
+    if ((client == NULL) || (requests == NULL) || (count == 0))
+    {
+        return IID_INVALID_PARAMETERS;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        if ((requests[i].key == NULL) || (requests[i].key_length > 1024))
+        {
+            return IID_INVALID_PARAMETERS;
+        }
+    }
+
+    pthread_mutex_lock(&client->lock);
+    while (received < count)
+    {
+        while ((sent < count) && ((sent - received) < CLIENT_PIPELINE_DEPTH))
+        {
+            if (!client_send(client, BK_SERVICE_WRAP, requests[sent].index, 0,
+                             requests[sent].key, requests[sent].key_length))
+            {
+                break;
+            }
+            sent++;
+        }
+
+        if ((sent == received) ||
+            !client_receive(client, &response, requests[received].key_code,
+                            (uint16_t)(BK_KEY_CODE_HEADER_SIZE_BYTES + requests[received].key_length)))
+        {
+            for (; received < count; received++)
+            {
+                requests[received].status = IID_ERROR_RESOURCES;
+            }
+            rc = (rc == IID_SUCCESS) ? IID_ERROR_RESOURCES : rc;
+            break;
+        }
+
+        requests[received].status = response.status;
+        if ((response.status != IID_SUCCESS) && (rc == IID_SUCCESS))
+        {
+            rc = response.status;
+        }
+        received++;
+    }
+    pthread_mutex_unlock(&client->lock);
+
+    return rc;
+}
+
+iid_return_t bk_client_unwrap(      bk_client_t * const client,
+                              const uint8_t     * const key_code,
+                              const uint16_t            key_code_size,
+                                    uint8_t     * const key,
+                                    uint16_t    * const key_length,
+                                    uint8_t     * const index)
+{
+    client_response_t response;
+    iid_return_t      rc;
+
+    if ((client == NULL) || (key_code == NULL) || (key == NULL) || (key_length == NULL) ||
+        (index == NULL) || (key_code_size <= BK_KEY_CODE_HEADER_SIZE_BYTES) ||
+        (key_code_size > BK_SERVICE_MAX_PAYLOAD_BYTES))
+    {
+        return IID_INVALID_PARAMETERS;
+    }
+
+    pthread_mutex_lock(&client->lock);
+    if (!client_send(client, BK_SERVICE_UNWRAP, 0, 0, key_code, key_code_size) ||
+        !client_receive(client, &response, key, (uint16_t)(key_code_size - BK_KEY_CODE_HEADER_SIZE_BYTES)))
+    {
+        rc = IID_ERROR_RESOURCES;
+    }
+    else
+    {
+        rc = response.status;
+        if (rc == IID_SUCCESS)
+        {
+            *key_length = response.length;
+            *index      = response.index;
+        }
+    }
+    pthread_mutex_unlock(&client->lock);
+
+    return rc;
+}
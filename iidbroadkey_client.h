@@ -0,0 +1,153 @@
+/*
+Copyright (c) 2017, prpl Foundation
+Permission to use, copy, modify, and/or distribute this software for any purpose with or without
+fee is hereby granted, provided that the above copyright notice and this permission notice appear
+in all copies.
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE
+INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE
+FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION,
+ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+#ifndef __IID_BROADKEY_CLIENT__H__
+#define __IID_BROADKEY_CLIENT__H__
+
+#include "iidbroadkey.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/************************************************************************
+*                        D E F I N I T I O N S                          *
+*************************************************************************/
+/* Key service protocol, spoken over a SOCK_SEQPACKET Unix domain socket
+   between the clients below and the bkd daemon (daemon/bkd.c). Every
+   message is one packet: a header of BK_SERVICE_HEADER_SIZE_BYTES bytes
+   followed by a payload, integers little-endian.
+
+   request   0  uint8  operation, see bk_service_op_t
+             1  uint8  index (get_key, wrap)
+             2  uint16 payload length
+             4  uint32 key_type (get_key)
+             8  payload: key (wrap), key code (unwrap), none (get_key)
+
+   response  0  uint8  return code
+             1  uint8  index (unwrap)
+             2  uint16 payload length, 0 unless the return code is IID_SUCCESS
+             4  uint32 reserved, 0
+             8  payload: key (get_key, unwrap), key code (wrap)
+
+   Responses are sent in the order of the requests of a connection. */
+
+#define BK_SERVICE_HEADER_SIZE_BYTES   8
+#define BK_SERVICE_MAX_PAYLOAD_BYTES   (BK_KEY_CODE_HEADER_SIZE_BYTES + 1024)
+#define BK_SERVICE_MAX_MESSAGE_BYTES   (BK_SERVICE_HEADER_SIZE_BYTES + BK_SERVICE_MAX_PAYLOAD_BYTES)
+
+/*! \brief Default path of the key service socket.
+*/
+#define BK_SERVICE_DEFAULT_PATH        "/run/bkd.sock"
+
+/*! \brief Defines the operations of the key service protocol.
+*/
+typedef enum bk_service_op {
+    BK_SERVICE_GET_KEY             = 0x01,
+    BK_SERVICE_WRAP                = 0x02,
+    BK_SERVICE_UNWRAP              = 0x03
+} bk_service_op_t;
+
+/*! \brief Opaque connection to the key service.
+*/
+typedef struct bk_client bk_client_t;
+
+
+/****************************************************************************
+*                      P U B L I C  I N T E R F A C E                       *
+*****************************************************************************/
+/*! \brief Connect to the key service.
+
+    \details A connection can be shared by several threads; their calls are serialized.
+             A send or receive error, or a malformed response, closes the connection:
+             the call that hit it and every later call on it return
+             \ref IID_ERROR_RESOURCES. Close it and connect again.
+
+    \param[in] *path Path of the key service socket, or NULL for \ref BK_SERVICE_DEFAULT_PATH.
+
+    \param[out] **client Pointer to a buffer which will hold the connection.
+
+    \returns \ref IID_SUCCESS if success, \ref IID_ERROR_RESOURCES if the service could not
+             be reached, otherwise another return code.
+*/
+iid_return_t bk_client_connect(const char        *  const path,
+                                     bk_client_t ** const client);
+
+
+/*! \brief Close a connection to the key service.
+
+    \param[in] *client The connection.
+
+    \returns \ref IID_SUCCESS if success, otherwise another return code.
+*/
+iid_return_t bk_client_close(bk_client_t * const client);
+
+
+/*! \brief Get a device-specific key from the key service. See \ref bk_get_key.
+
+    \returns The return code of \ref bk_get_key in the service, or \ref IID_ERROR_RESOURCES
+             if the connection failed.
+*/
+iid_return_t bk_client_get_key(      bk_client_t * const client,
+                               const key_type_t          key_type,
+                               const uint8_t             index,
+                                     uint8_t     * const key);
+
+
+/*! \brief Get several device-specific keys from the key service. See \ref bk_get_key_batch.
+
+    \details The requests are pipelined on the connection, and the service processes
+             the requests of all its clients in batches.
+*/
+iid_return_t bk_client_get_key_batch(      bk_client_t      * const client,
+                                           bk_key_request_t * const requests,
+                                     const uint16_t                 count);
+
+
+/*! \brief Wrap a key into a key code with the key service. See \ref bk_wrap.
+*/
+iid_return_t bk_client_wrap(      bk_client_t * const client,
+                            const uint8_t             index,
+                            const uint8_t     * const key,
+                            const uint16_t            key_length,
+                                  uint8_t     * const key_code);
+
+
+/*! \brief Wrap several keys with the key service. See \ref bk_wrap_batch.
+
+    \details The requests are pipelined as in \ref bk_client_get_key_batch.
+*/
+iid_return_t bk_client_wrap_batch(      bk_client_t       * const client,
+                                        bk_wrap_request_t * const requests,
+                                  const uint16_t                  count);
+
+
+/*! \brief Unwrap a key code with the key service. See \ref bk_unwrap.
+
+    \details Unlike \ref bk_unwrap, the size of the key code must be given, since
+             it has to be sent to the service.
+
+    \param[in] key_code_size The size in bytes of \ref key_code, that is
+                             \ref BK_KEY_CODE_HEADER_SIZE_BYTES + the key length.
+*/
+iid_return_t bk_client_unwrap(      bk_client_t * const client,
+                              const uint8_t     * const key_code,
+                              const uint16_t            key_code_size,
+                                    uint8_t     * const key,
+                                    uint16_t    * const key_length,
+                                    uint8_t     * const index);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __IID_BROADKEY_CLIENT__H__ */
@@ -0,0 +1,271 @@
+/*
+Copyright (c) 2017, prpl Foundation
+Permission to use, copy, modify, and/or distribute this software for any purpose with or without
+fee is hereby granted, provided that the above copyright notice and this permission notice appear
+in all copies.
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE
+INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE
+FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION,
+ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+#include <stdlib.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "iidbroadkey_provision.h"
+#include "iidreturn_codes.h"
+
+/************************************************************************
+*                        D E F I N I T I O N S                          *
+*************************************************************************/
+/* Devices [begin, end) not yet taken by any thread. The owner takes from
+   begin, thieves take from end. */
+typedef struct provision_worker {
+    pthread_t                    thread;
+    pthread_mutex_t              lock;
+    uint32_t                     begin;
+    uint32_t                     end;
+    bk_ctx_t                   * ctx;
+    struct provision_job       * job;
+} provision_worker_t;
+
+typedef struct provision_job {
+    bk_provision_item_t        * items;
+    provision_worker_t         * workers;
+    uint16_t                     worker_count;
+} provision_job_t;
+
+
+/****************************************************************************
+*                     P R I V A T E  F U N C T I O N S                      *
+*****************************************************************************/
+static void provision_wipe(      void   * const buffer,
+                           const size_t         size)
+{
+    volatile uint8_t * p = (volatile uint8_t *)buffer;
+    size_t             i;
+
+    for (i = 0; i < size; i++)
+    {
+        p[i] = 0;
+    }
+}
+
+static bool provision_take(provision_worker_t * const worker,
+                           uint32_t           * const item)
+{
+    bool taken = false;
+
+    pthread_mutex_lock(&worker->lock);
+    if (worker->begin < worker->end)
+    {
+        *item = worker->begin++;
+        taken = true;
+    }
+    pthread_mutex_unlock(&worker->lock);
+
+    return taken;
+}
+
+/* Moves half of the remaining devices of the first victim found, rounded up,
+   to thief. Only one lock is held at a time; the range of thief is empty
+   while it steals, so no other thread can take from it meanwhile. */
+static bool provision_steal(provision_worker_t * const thief)
+{
+    provision_job_t * const job = thief->job;
+    provision_worker_t    * victim;
+    uint32_t                begin = 0;
+    uint32_t                end   = 0;
+    uint16_t                i;
+
+    for (i = 0; (i < job->worker_count) && (begin == end); i++)
+    {
+        victim = &job->workers[i];
+        if (victim == thief)
+        {
+            continue;
+        }
+
+        pthread_mutex_lock(&victim->lock);
+        if (victim->begin < victim->end)
+        {
+            end         = victim->end;
+            begin       = end - (((victim->end - victim->begin) + 1) / 2);
+            victim->end = begin;
+        }
+        pthread_mutex_unlock(&victim->lock);
+    }
+
+    if (begin == end)
+    {
+        return false;
+    }
+
+    pthread_mutex_lock(&thief->lock);
+    thief->begin = begin;
+    thief->end   = end;
+    pthread_mutex_unlock(&thief->lock);
+
+    return true;
+}
+
+/* Empties every range, so that running threads stop after their current device. */
+static void provision_abort(provision_job_t * const job)
+{
+    uint16_t i;
+
+    for (i = 0; i < job->worker_count; i++)
+    {
+        pthread_mutex_lock(&job->workers[i].lock);
+        job->workers[i].end = job->workers[i].begin;
+        pthread_mutex_unlock(&job->workers[i].lock);
+    }
+}
+
+static void provision_enroll_one(      bk_ctx_t            * const ctx,
+                                       bk_provision_item_t * const item)
+{
+    item->status = bk_ctx_init(ctx, item->sram_puf, item->sram_puf_size);
+    if (item->status == IID_SUCCESS)
+    {
+        item->status = bk_ctx_enroll(ctx, item->activation_code);
+    }
+    (void)bk_ctx_stop(ctx);
+}
+
+static void * provision_worker_main(void * const arg)
+{
+    provision_worker_t * const worker = (provision_worker_t *)arg;
+    uint32_t                   item;
+
+    for (;;)
+    {
+        while (provision_take(worker, &item))
+        {
+            provision_enroll_one(worker->ctx, &worker->job->items[item]);
+        }
+
+        if (!provision_steal(worker))
+        {
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+
+/****************************************************************************
+*                      P U B L I C  F U N C T I O N S                       *
+*****************************************************************************/
+iid_return_t bk_provision_enroll(      bk_provision_item_t * const items,
+                                 const uint32_t                    count,
+                                 const uint16_t                    threads)
+{
+    provision_job_t job;
+    uint16_t        ctx_size;
+    size_t          ctx_stride;
+    uint8_t       * ctx_memory;
+    uint16_t        started = 0;
+    long            cpus;
+    uint32_t        i;
+    iid_return_t    rc;
+
+    if ((items == NULL) || (count == 0))
+    {
+        return IID_INVALID_PARAMETERS;
+    }
+
+    rc = bk_ctx_get_size(&ctx_size);
+    if (rc != IID_SUCCESS)
+    {
+        return rc;
+    }
+
+    job.items        = items;
+    job.worker_count = threads;
+    if (job.worker_count == 0)
+    {
+        cpus             = sysconf(_SC_NPROCESSORS_ONLN);
+        job.worker_count = ((cpus > 0) && (cpus <= UINT16_MAX)) ? (uint16_t)cpus : 1;
+    }
+    if (job.worker_count > count)
+    {
+        job.worker_count = (uint16_t)count;
+    }
+
+    /* Context sizes are rounded up to a word so that every context is 32-bit aligned.
+       The stride is computed in size_t, a size close to UINT16_MAX cannot wrap. */
+    ctx_stride  = ((size_t)ctx_size + WORD_BYTE - 1) & ~((size_t)WORD_BYTE - 1);
+    job.workers = (provision_worker_t *)calloc(job.worker_count, sizeof(provision_worker_t));
+    ctx_memory  = (uint8_t *)calloc(job.worker_count, ctx_stride);
+    if ((job.workers == NULL) || (ctx_memory == NULL))
+    {
+        free(job.workers);
+        free(ctx_memory);
+        return IID_ERROR_RESOURCES;
+    }
+
+    for (i = 0; i < job.worker_count; i++)
+    {
+        job.workers[i].begin = (uint32_t)(((uint64_t)count * i) / job.worker_count);
+        job.workers[i].end   = (uint32_t)(((uint64_t)count * (i + 1)) / job.worker_count);
+        job.workers[i].ctx   = (bk_ctx_t *)&ctx_memory[(size_t)i * ctx_stride];
+        job.workers[i].job   = &job;
+        pthread_mutex_init(&job.workers[i].lock, NULL);
+    }
+
+    /* Devices not processed because a thread could not be started keep this status. */
+    for (i = 0; i < count; i++)
+    {
+        items[i].status = IID_ERROR_RESOURCES;
+    }
+
+    /* The calling thread runs worker 0. */
+    rc = IID_SUCCESS;
+    for (i = 1; i < job.worker_count; i++)
+    {
+        if (pthread_create(&job.workers[i].thread, NULL, provision_worker_main, &job.workers[i]) != 0)
+        {
+            rc = IID_ERROR_RESOURCES;
+            provision_abort(&job);
+            break;
+        }
+        started++;
+    }
+
+    if (rc == IID_SUCCESS)
+    {
+        (void)provision_worker_main(&job.workers[0]);
+    }
+
+    for (i = 1; i <= started; i++)
+    {
+        pthread_join(job.workers[i].thread, NULL);
+    }
+
+    for (i = 0; i < job.worker_count; i++)
+    {
+        pthread_mutex_destroy(&job.workers[i].lock);
+    }
+
+    provision_wipe(ctx_memory, (size_t)job.worker_count * ctx_stride);
+    free(ctx_memory);
+    free(job.workers);
+
+    if (rc != IID_SUCCESS)
+    {
+        return rc;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        if (items[i].status != IID_SUCCESS)
+        {
+            return items[i].status;
+        }
+    }
+
+    return IID_SUCCESS;
+}
@@ -0,0 +1,71 @@
+/*
+Copyright (c) 2017, prpl Foundation
+Permission to use, copy, modify, and/or distribute this software for any purpose with or without
+fee is hereby granted, provided that the above copyright notice and this permission notice appear
+in all copies.
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE
+INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE
+FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION,
+ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+#ifndef __IID_BROADKEY_PROVISION__H__
+#define __IID_BROADKEY_PROVISION__H__
+
+#include "iidbroadkey.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/************************************************************************
+*                        D E F I N I T I O N S                          *
+*************************************************************************/
+/*! \brief Describes one device in a \ref bk_provision_enroll call.
+*/
+typedef struct bk_provision_item {
+    uint8_t            * sram_puf;        /*!< SRAM start-up image of the device, as for \ref bk_init. */
+    uint16_t             sram_puf_size;   /*!< Size in bytes of sram_puf, at least \ref BK_SRAM_SIZE_BYTES. */
+    uint8_t            * activation_code; /*!< Output buffer of \ref BK_AC_SIZE_BYTES bytes, 32-bit aligned. */
+    iid_return_t         status;          /*!< Result of this enrollment, set by \ref bk_provision_enroll. */
+} bk_provision_item_t;
+
+
+/****************************************************************************
+*                      P U B L I C  I N T E R F A C E                       *
+*****************************************************************************/
+/*! \brief Enroll many devices in parallel.
+
+    \details Generates the activation code of every device described by \ref items,
+             as \ref bk_init followed by \ref bk_enroll would on that device, using a
+             private context per thread. The devices are split evenly over the threads;
+             a thread that runs out of devices takes half of the remaining devices of
+             another thread.
+             It does not use the default context and can be called in any state.
+
+    \param[in,out] *items Pointer to an array of \ref bk_provision_item_t descriptors.
+                          On return, the status field of every descriptor holds the
+                          return code of its own enrollment, \ref IID_ERROR_STARTUP_DATA
+                          when the image cannot be used as an SRAM PUF.
+
+    \param[in] count Number of descriptors in \ref items.
+
+    \param[in] threads Number of threads to use, or 0 for one per online processor.
+
+    \returns \ref IID_SUCCESS if all devices were enrolled, \ref IID_ERROR_RESOURCES if
+             memory or threads could not be obtained, otherwise the return code of the
+             first descriptor that failed. When a thread cannot be started, the threads
+             already running stop after their current device and are joined before
+             returning; the devices enrolled so far have status \ref IID_SUCCESS, the
+             others \ref IID_ERROR_RESOURCES.
+*/
+iid_return_t bk_provision_enroll(      bk_provision_item_t * const items,
+                                 const uint32_t                    count,
+                                 const uint16_t                    threads);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __IID_BROADKEY_PROVISION__H__ */
@@ -0,0 +1,723 @@
+/*
+Copyright (c) 2017, prpl Foundation
+Permission to use, copy, modify, and/or distribute this software for any purpose with or without
+fee is hereby granted, provided that the above copyright notice and this permission notice appear
+in all copies.
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE
+INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE
+FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION,
+ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+#include "iidbroadkey_shm.h"
+#include "iidreturn_codes.h"
+
+/************************************************************************
+*                        D E F I N I T I O N S                          *
+*************************************************************************/
+#define SHM_MAGIC                      0x4D534B42u /* "BKSM" */
+#define SHM_VERSION                    1
+#define SHM_MAX_SLOTS                  65536
+#define SHM_CACHE_LINE                 64
+#define SHM_MAX_KEY_CODE_BYTES         (BK_KEY_CODE_HEADER_SIZE_BYTES + 1024)
+#define SHM_MAX_KEY_BYTES              1024
+
+/* Number of polls before a side goes to sleep on its futex. */
+#define SHM_SPIN_COUNT                 2048
+
+/* Period at which a sleeping client checks that the owner process still exists. */
+#define SHM_LIVENESS_PERIOD_NS         100000000L
+
+/* How long bk_shm_serve waits, after stop, for clients in the middle of a
+   submission, and how long it sleeps between two checks. */
+#define SHM_STOP_TIMEOUT_NS            1000000000L
+#define SHM_STOP_POLL_NS               1000000L
+
+/* Slot states. A client moves a slot from FREE to CLAIMED and on to SUBMITTED;
+   it changes SUBMITTED to WAITING before sleeping. The owner moves SUBMITTED
+   or WAITING to DONE, and only wakes the client in the second case. */
+#define SHM_SLOT_FREE                  0
+#define SHM_SLOT_CLAIMED               1
+#define SHM_SLOT_SUBMITTED             2
+#define SHM_SLOT_WAITING               3
+#define SHM_SLOT_DONE                  4
+
+#define SHM_OWNER_RUNNING              0
+#define SHM_OWNER_SLEEPING             1
+
+/* Producer and consumer positions live on their own cache lines. */
+typedef struct shm_header {
+    uint32_t        magic;
+    uint32_t        version;
+    uint32_t        slot_count;
+    uint32_t        slot_size;
+    uint32_t        stop;
+    uint32_t        owner_state;
+    uint32_t        next_slot;
+    uint32_t        submitters;
+    uint32_t        owner_pid;
+    uint32_t        reserved0[7];
+    uint32_t        enqueue_position;
+    uint32_t        reserved1[15];
+    uint32_t        dequeue_position;
+    uint32_t        reserved2[15];
+} shm_header_t;
+
+/* Cell of the bounded multi-producer ring of submitted slot numbers. */
+typedef struct shm_cell {
+    uint32_t        sequence;
+    uint32_t        slot;
+} shm_cell_t;
+
+struct bk_shm_slot {
+    uint32_t        state;
+    uint32_t        key_code_size;
+    uint32_t        key_length;
+    uint32_t        index;
+    uint32_t        status;
+    uint32_t        reserved0[11];
+    uint32_t        key_code[SHM_MAX_KEY_CODE_BYTES / WORD_BYTE];
+    uint32_t        key[SHM_MAX_KEY_BYTES / WORD_BYTE];
+    uint32_t        reserved1[5];
+};
+
+typedef char shm_header_size_check[(sizeof(shm_header_t) == 3 * SHM_CACHE_LINE) ? 1 : -1];
+typedef char shm_slot_size_check[(sizeof(bk_shm_slot_t) == BK_SHM_SLOT_SIZE_BYTES) ? 1 : -1];
+
+/* slot_count is a private copy of the validated header field: the header is
+   writable by every client. */
+struct bk_shm {
+    shm_header_t  * header;
+    shm_cell_t    * cells;
+    bk_shm_slot_t * slots;
+    uint32_t        slot_count;
+    size_t          size;
+    char          * name;
+};
+
+
+/****************************************************************************
+*                     P R I V A T E  F U N C T I O N S                      *
+*****************************************************************************/
+static size_t shm_cells_size(const uint32_t slot_count)
+{
+    size_t size = (size_t)slot_count * sizeof(shm_cell_t);
+
+    return (size + SHM_CACHE_LINE - 1) & ~(size_t)(SHM_CACHE_LINE - 1);
+}
+
+static size_t shm_region_size(const uint32_t slot_count)
+{
+    return sizeof(shm_header_t) + shm_cells_size(slot_count)
+         + (size_t)slot_count * sizeof(bk_shm_slot_t);
+}
+
+static void shm_layout(      bk_shm_t * const shm,
+                             void     * const base,
+                       const uint32_t         slot_count,
+                       const size_t           size)
+{
+    shm->header     = (shm_header_t *)base;
+    shm->cells      = (shm_cell_t *)((uint8_t *)base + sizeof(shm_header_t));
+    shm->slots      = (bk_shm_slot_t *)((uint8_t *)shm->cells + shm_cells_size(slot_count));
+    shm->slot_count = slot_count;
+    shm->size       = size;
+}
+
+static void shm_wipe(      void   * const buffer,
+                     const size_t         size)
+{
+    volatile uint8_t * p = (volatile uint8_t *)buffer;
+    size_t             i;
+
+    for (i = 0; i < size; i++)
+    {
+        p[i] = 0;
+    }
+}
+
+static inline void shm_relax(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+    __asm__ __volatile__("yield" ::: "memory");
+#endif
+}
+
+/* The region is shared between processes, so the futex operations must not
+   use FUTEX_PRIVATE_FLAG. */
+static void shm_futex_wait(      uint32_t        * const word,
+                           const uint32_t                value,
+                           const struct timespec * const timeout)
+{
+    (void)syscall(SYS_futex, word, FUTEX_WAIT, value, timeout, NULL, 0);
+}
+
+static void shm_futex_wake(uint32_t * const word)
+{
+    (void)syscall(SYS_futex, word, FUTEX_WAKE, 1, NULL, NULL, 0);
+}
+
+/* The owner is gone when bk_shm_serve has returned, which clears owner_pid,
+   or when its process does not exist anymore. Clients must run in the PID
+   namespace of the owner. */
+static bool shm_owner_alive(const shm_header_t * const header)
+{
+    const pid_t owner = (pid_t)__atomic_load_n(&header->owner_pid, __ATOMIC_ACQUIRE);
+
+    return (owner > 0) && ((kill(owner, 0) == 0) || (errno != ESRCH));
+}
+
+static void shm_enqueue(      bk_shm_t * const shm,
+                        const uint32_t         slot)
+{
+    const uint32_t   mask = shm->slot_count - 1;
+    uint32_t         position;
+    uint32_t         sequence;
+    shm_cell_t     * cell;
+
+    position = __atomic_load_n(&shm->header->enqueue_position, __ATOMIC_RELAXED);
+    for (;;)
+    {
+        cell     = &shm->cells[position & mask];
+        sequence = __atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE);
+        if (sequence == position)
+        {
+            if (__atomic_compare_exchange_n(&shm->header->enqueue_position, &position, position + 1,
+                                            true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+            {
+                break;
+            }
+        }
+        else
+        {
+            /* There are as many cells as slots and a slot is queued at most
+               once, so the ring is never full and the cell is about to be
+               released by the owner or taken by another client. */
+            shm_relax();
+            position = __atomic_load_n(&shm->header->enqueue_position, __ATOMIC_RELAXED);
+        }
+    }
+
+    cell->slot = slot;
+    __atomic_store_n(&cell->sequence, position + 1, __ATOMIC_RELEASE);
+}
+
+static bool shm_dequeue(bk_shm_t * const shm,
+                        uint32_t * const slot)
+{
+    const uint32_t   mask     = shm->slot_count - 1;
+    const uint32_t   position = shm->header->dequeue_position;
+    shm_cell_t     * cell     = &shm->cells[position & mask];
+
+    if (__atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE) != position + 1)
+    {
+        return false;
+    }
+
+    *slot = cell->slot;
+    shm->header->dequeue_position = position + 1;
+    __atomic_store_n(&cell->sequence, position + mask + 1, __ATOMIC_RELEASE);
+
+    return true;
+}
+
+static bool shm_queue_empty(bk_shm_t * const shm)
+{
+    const uint32_t position = shm->header->dequeue_position;
+    shm_cell_t *   cell     = &shm->cells[position & (shm->slot_count - 1)];
+
+    return __atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE) != position + 1;
+}
+
+static void shm_complete(bk_shm_slot_t * const slot,
+                         iid_return_t          status)
+{
+    slot->status = status;
+    if (__atomic_exchange_n(&slot->state, SHM_SLOT_DONE, __ATOMIC_ACQ_REL) == SHM_SLOT_WAITING)
+    {
+        shm_futex_wake(&slot->state);
+    }
+}
+
+static bk_shm_slot_t * shm_take(bk_shm_t * const shm)
+{
+    uint32_t        number;
+    uint32_t        state;
+    bk_shm_slot_t * slot;
+
+    while (shm_dequeue(shm, &number))
+    {
+        /* The ring is writable by every client; ignore what does not name a
+           submitted slot. */
+        if (number >= shm->slot_count)
+        {
+            continue;
+        }
+        slot  = &shm->slots[number];
+        state = __atomic_load_n(&slot->state, __ATOMIC_ACQUIRE);
+        if ((state == SHM_SLOT_SUBMITTED) || (state == SHM_SLOT_WAITING))
+        {
+            return slot;
+        }
+    }
+
+    return NULL;
+}
+
+static bool shm_slot_valid(const bk_shm_t      * const shm,
+                           const bk_shm_slot_t * const slot)
+{
+    const uintptr_t offset = (uintptr_t)slot - (uintptr_t)shm->slots;
+
+    return ((uintptr_t)slot >= (uintptr_t)shm->slots)
+        && (offset % sizeof(bk_shm_slot_t) == 0)
+        && (offset / sizeof(bk_shm_slot_t) < shm->slot_count);
+}
+
+static iid_return_t shm_map(const char     *  const name,
+                            const int                fd,
+                            const size_t             size,
+                                  bk_shm_t ** const  shm)
+{
+    bk_shm_t * result;
+    void     * base;
+
+    result = (bk_shm_t *)malloc(sizeof(bk_shm_t));
+    if (result == NULL)
+    {
+        return IID_ERROR_RESOURCES;
+    }
+    result->name = strdup(name);
+    if (result->name == NULL)
+    {
+        free(result);
+        return IID_ERROR_RESOURCES;
+    }
+
+    base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED)
+    {
+        free(result->name);
+        free(result);
+        return IID_ERROR_RESOURCES;
+    }
+
+    result->header = (shm_header_t *)base;
+    result->size   = size;
+    *shm = result;
+
+    return IID_SUCCESS;
+}
+
+static void shm_unmap(bk_shm_t * const shm)
+{
+    (void)munmap(shm->header, shm->size);
+    free(shm->name);
+    free(shm);
+}
+
+
+/****************************************************************************
+*                      P U B L I C  F U N C T I O N S                       *
+*****************************************************************************/
+iid_return_t bk_shm_create(const char     *  const name,
+                           const uint32_t          slot_count,
+                                 bk_shm_t ** const shm)
+{
+    iid_return_t   result;
+    size_t         size;
+    uint32_t       i;
+    int            fd;
+
+    if ((name == NULL) || (shm == NULL) || (slot_count == 0) || (slot_count > SHM_MAX_SLOTS)
+        || ((slot_count & (slot_count - 1)) != 0))
+    {
+        return IID_INVALID_PARAMETERS;
+    }
+
+    size = shm_region_size(slot_count);
+    fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, S_IRUSR | S_IWUSR);
+    if (fd < 0)
+    {
+        return IID_ERROR_RESOURCES;
+    }
+    if (ftruncate(fd, (off_t)size) != 0)
+    {
+        (void)close(fd);
+        (void)shm_unlink(name);
+        return IID_ERROR_RESOURCES;
+    }
+
+    result = shm_map(name, fd, size, shm);
+    (void)close(fd);
+    if (result != IID_SUCCESS)
+    {
+        (void)shm_unlink(name);
+        return result;
+    }
+
+    /* ftruncate zero-fills the region: every slot starts FREE. */
+    (*shm)->header->slot_count = slot_count;
+    (*shm)->header->slot_size  = sizeof(bk_shm_slot_t);
+    (*shm)->header->version    = SHM_VERSION;
+    (*shm)->header->owner_pid  = (uint32_t)getpid();
+    shm_layout(*shm, (*shm)->header, slot_count, size);
+    for (i = 0; i < slot_count; i++)
+    {
+        (*shm)->cells[i].sequence = i;
+    }
+    __atomic_store_n(&(*shm)->header->magic, SHM_MAGIC, __ATOMIC_RELEASE);
+
+    return IID_SUCCESS;
+}
+
+iid_return_t bk_shm_serve(bk_shm_t * const shm)
+{
+    const struct timespec stop_poll = { 0, SHM_STOP_POLL_NS };
+    bk_unwrap_request_t   requests[BK_SHM_SERVE_BATCH_SIZE];
+    bk_shm_slot_t       * slots[BK_SHM_SERVE_BATCH_SIZE];
+    bk_shm_slot_t       * slot;
+    shm_header_t        * header;
+    long                  waited;
+    uint32_t              spins = 0;
+    uint16_t              count;
+    uint16_t              i;
+
+    if (shm == NULL)
+    {
+        return IID_INVALID_PARAMETERS;
+    }
+    header = shm->header;
+    __atomic_store_n(&header->owner_pid, (uint32_t)getpid(), __ATOMIC_RELAXED);
+
+    while (__atomic_load_n(&header->stop, __ATOMIC_SEQ_CST) == 0)
+    {
+        count = 0;
+        while ((count < BK_SHM_SERVE_BATCH_SIZE) && ((slot = shm_take(shm)) != NULL))
+        {
+            if ((slot->key_code_size <= BK_KEY_CODE_HEADER_SIZE_BYTES)
+                || (slot->key_code_size > SHM_MAX_KEY_CODE_BYTES)
+                || ((slot->key_code_size % WORD_BYTE) != 0))
+            {
+                shm_complete(slot, IID_INVALID_PARAMETERS);
+                continue;
+            }
+            requests[count].key_code = (const uint8_t *)slot->key_code;
+            requests[count].key      = (uint8_t *)slot->key;
+            slots[count] = slot;
+            count++;
+        }
+
+        if (count != 0)
+        {
+            (void)bk_unwrap_batch(requests, count);
+            for (i = 0; i < count; i++)
+            {
+                if (requests[i].status == IID_SUCCESS)
+                {
+                    slots[i]->key_length = requests[i].key_length;
+                    slots[i]->index      = requests[i].index;
+                }
+                shm_complete(slots[i], requests[i].status);
+            }
+            spins = 0;
+            continue;
+        }
+
+        if (spins < SHM_SPIN_COUNT)
+        {
+            shm_relax();
+            spins++;
+            continue;
+        }
+
+        /* Announce the sleep before the last look at the ring, so that a
+           client enqueueing concurrently either is seen here or sees the
+           announcement and wakes us up. */
+        __atomic_store_n(&header->owner_state, SHM_OWNER_SLEEPING, __ATOMIC_SEQ_CST);
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        if (shm_queue_empty(shm) && (__atomic_load_n(&header->stop, __ATOMIC_ACQUIRE) == 0))
+        {
+            shm_futex_wait(&header->owner_state, SHM_OWNER_SLEEPING, NULL);
+        }
+        __atomic_store_n(&header->owner_state, SHM_OWNER_RUNNING, __ATOMIC_RELAXED);
+        spins = 0;
+    }
+
+    /* A client that read stop as 0 is counted in submitters until its slot is
+       in the ring. Stop is set before this read in the total order of the
+       seq_cst operations, so every later client sees it and does not submit.
+       A client that died in between never leaves the count, hence the deadline. */
+    for (waited = 0; (__atomic_load_n(&header->submitters, __ATOMIC_SEQ_CST) != 0)
+                     && (waited < SHM_STOP_TIMEOUT_NS); waited += SHM_STOP_POLL_NS)
+    {
+        (void)nanosleep(&stop_poll, NULL);
+    }
+
+    /* Do not leave clients waiting on requests that will never be served. */
+    while ((slot = shm_take(shm)) != NULL)
+    {
+        shm_complete(slot, IID_NOT_ALLOWED);
+    }
+
+    /* Clients still waiting, on a slot submitted after the deadline or behind
+       a cell that a dead client never published, see this and give up. */
+    __atomic_store_n(&header->owner_pid, 0, __ATOMIC_RELEASE);
+
+    return IID_SUCCESS;
+}
+
+iid_return_t bk_shm_stop(bk_shm_t * const shm)
+{
+    if (shm == NULL)
+    {
+        return IID_INVALID_PARAMETERS;
+    }
+
+    __atomic_store_n(&shm->header->stop, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_exchange_n(&shm->header->owner_state, SHM_OWNER_RUNNING, __ATOMIC_SEQ_CST)
+        == SHM_OWNER_SLEEPING)
+    {
+        shm_futex_wake(&shm->header->owner_state);
+    }
+
+    return IID_SUCCESS;
+}
+
+iid_return_t bk_shm_destroy(bk_shm_t * const shm)
+{
+    if (shm == NULL)
+    {
+        return IID_INVALID_PARAMETERS;
+    }
+
+    (void)shm_unlink(shm->name);
+    shm_wipe(shm->slots, (size_t)shm->slot_count * sizeof(bk_shm_slot_t));
+    shm_unmap(shm);
+
+    return IID_SUCCESS;
+}
+
+iid_return_t bk_shm_attach(const char     *  const name,
+                                 bk_shm_t ** const shm)
+{
+    const shm_header_t * header;
+    iid_return_t         result;
+    struct stat          status;
+    uint32_t             slot_count;
+    int                  fd;
+
+    if ((name == NULL) || (shm == NULL))
+    {
+        return IID_INVALID_PARAMETERS;
+    }
+
+    fd = shm_open(name, O_RDWR, 0);
+    if (fd < 0)
+    {
+        return IID_ERROR_RESOURCES;
+    }
+    if (fstat(fd, &status) != 0)
+    {
+        (void)close(fd);
+        return IID_ERROR_RESOURCES;
+    }
+    if ((size_t)status.st_size < sizeof(shm_header_t))
+    {
+        (void)close(fd);
+        return IID_INVALID_PARAMETERS;
+    }
+
+    result = shm_map(name, fd, (size_t)status.st_size, shm);
+    (void)close(fd);
+    if (result != IID_SUCCESS)
+    {
+        return result;
+    }
+
+    header     = (*shm)->header;
+    slot_count = __atomic_load_n(&header->slot_count, __ATOMIC_RELAXED);
+    if ((__atomic_load_n(&header->magic, __ATOMIC_ACQUIRE) != SHM_MAGIC)
+        || (header->version != SHM_VERSION)
+        || (header->slot_size != sizeof(bk_shm_slot_t))
+        || (slot_count == 0) || (slot_count > SHM_MAX_SLOTS)
+        || ((slot_count & (slot_count - 1)) != 0)
+        || (shm_region_size(slot_count) != (size_t)status.st_size))
+    {
+        shm_unmap(*shm);
+        *shm = NULL;
+        return IID_INVALID_PARAMETERS;
+    }
+    shm_layout(*shm, (*shm)->header, slot_count, (size_t)status.st_size);
+
+    return IID_SUCCESS;
+}
+
+iid_return_t bk_shm_detach(bk_shm_t * const shm)
+{
+    if (shm == NULL)
+    {
+        return IID_INVALID_PARAMETERS;
+    }
+
+    shm_unmap(shm);
+
+    return IID_SUCCESS;
+}
+
+iid_return_t bk_shm_acquire(bk_shm_t      *  const shm,
+                            bk_shm_slot_t ** const slot,
+                            uint8_t       ** const key_code)
+{
+    uint32_t slot_count;
+    uint32_t start;
+    uint32_t expected;
+    uint32_t i;
+
+    if ((shm == NULL) || (slot == NULL) || (key_code == NULL))
+    {
+        return IID_INVALID_PARAMETERS;
+    }
+
+    /* Start at a different slot on every call so that concurrent clients
+       rarely compete for the same one. */
+    slot_count = shm->slot_count;
+    start = __atomic_fetch_add(&shm->header->next_slot, 1, __ATOMIC_RELAXED);
+    for (i = 0; i < slot_count; i++)
+    {
+        bk_shm_slot_t * const candidate = &shm->slots[(start + i) & (slot_count - 1)];
+
+        expected = SHM_SLOT_FREE;
+        if (__atomic_compare_exchange_n(&candidate->state, &expected, SHM_SLOT_CLAIMED,
+                                        false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+        {
+            *slot     = candidate;
+            *key_code = (uint8_t *)candidate->key_code;
+            return IID_SUCCESS;
+        }
+    }
+
+    return IID_ERROR_RESOURCES;
+}
+
+iid_return_t bk_shm_unwrap(      bk_shm_t      *  const shm,
+                                 bk_shm_slot_t *  const slot,
+                           const uint16_t                key_code_size,
+                           const uint8_t       ** const key,
+                                 uint16_t      *  const key_length,
+                                 uint8_t       *  const index)
+{
+    const struct timespec period = { 0, SHM_LIVENESS_PERIOD_NS };
+    shm_header_t        * header;
+    uint32_t              state;
+    uint32_t              expected;
+    uint32_t              spins;
+
+    if ((shm == NULL) || (slot == NULL) || (key == NULL) || (key_length == NULL)
+        || (index == NULL) || (key_code_size > SHM_MAX_KEY_CODE_BYTES)
+        || !shm_slot_valid(shm, slot))
+    {
+        return IID_INVALID_PARAMETERS;
+    }
+    state = __atomic_load_n(&slot->state, __ATOMIC_RELAXED);
+    if ((state != SHM_SLOT_CLAIMED) && (state != SHM_SLOT_DONE))
+    {
+        return IID_NOT_ALLOWED;
+    }
+    header = shm->header;
+
+    /* Announce the submission before looking at stop, see bk_shm_serve. */
+    (void)__atomic_fetch_add(&header->submitters, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&header->stop, __ATOMIC_SEQ_CST) != 0)
+    {
+        (void)__atomic_fetch_sub(&header->submitters, 1, __ATOMIC_RELEASE);
+        return IID_NOT_ALLOWED;
+    }
+
+    slot->key_code_size = key_code_size;
+    __atomic_store_n(&slot->state, SHM_SLOT_SUBMITTED, __ATOMIC_RELEASE);
+    shm_enqueue(shm, (uint32_t)(slot - shm->slots));
+    (void)__atomic_fetch_sub(&header->submitters, 1, __ATOMIC_RELEASE);
+
+    /* Pairs with the fence of the owner before its last look at the ring. */
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_exchange_n(&header->owner_state, SHM_OWNER_RUNNING, __ATOMIC_SEQ_CST)
+        == SHM_OWNER_SLEEPING)
+    {
+        shm_futex_wake(&header->owner_state);
+    }
+
+    for (spins = 0; spins < SHM_SPIN_COUNT; spins++)
+    {
+        if (__atomic_load_n(&slot->state, __ATOMIC_ACQUIRE) == SHM_SLOT_DONE)
+        {
+            break;
+        }
+        shm_relax();
+    }
+    if (spins == SHM_SPIN_COUNT)
+    {
+        expected = SHM_SLOT_SUBMITTED;
+        (void)__atomic_compare_exchange_n(&slot->state, &expected, SHM_SLOT_WAITING,
+                                          false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+        while (__atomic_load_n(&slot->state, __ATOMIC_ACQUIRE) != SHM_SLOT_DONE)
+        {
+            shm_futex_wait(&slot->state, SHM_SLOT_WAITING, &period);
+            if ((__atomic_load_n(&slot->state, __ATOMIC_ACQUIRE) != SHM_SLOT_DONE)
+                && !shm_owner_alive(header))
+            {
+                return IID_NOT_ALLOWED;
+            }
+        }
+    }
+
+    if (slot->status != IID_SUCCESS)
+    {
+        return (iid_return_t)slot->status;
+    }
+    *key        = (const uint8_t *)slot->key;
+    *key_length = (uint16_t)slot->key_length;
+    *index      = (uint8_t)slot->index;
+
+    return IID_SUCCESS;
+}
+
+iid_return_t bk_shm_release(bk_shm_t      * const shm,
+                            bk_shm_slot_t * const slot)
+{
+    uint32_t state;
+
+    if ((shm == NULL) || (slot == NULL) || !shm_slot_valid(shm, slot))
+    {
+        return IID_INVALID_PARAMETERS;
+    }
+    state = __atomic_load_n(&slot->state, __ATOMIC_ACQUIRE);
+    if ((state != SHM_SLOT_CLAIMED) && (state != SHM_SLOT_DONE))
+    {
+        return IID_NOT_ALLOWED;
+    }
+
+    shm_wipe(slot->key_code, sizeof(slot->key_code));
+    shm_wipe(slot->key, sizeof(slot->key));
+    slot->key_length = 0;
+    slot->index      = 0;
+    __atomic_store_n(&slot->state, SHM_SLOT_FREE, __ATOMIC_RELEASE);
+
+    return IID_SUCCESS;
+}
@@ -0,0 +1,212 @@
+/*
+Copyright (c) 2017, prpl Foundation
+Permission to use, copy, modify, and/or distribute this software for any purpose with or without
+fee is hereby granted, provided that the above copyright notice and this permission notice appear
+in all copies.
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE
+INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE
+FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION,
+ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+#ifndef __IID_BROADKEY_SHM__H__
+#define __IID_BROADKEY_SHM__H__
+
+#include "iidbroadkey.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/************************************************************************
+*                        D E F I N I T I O N S                          *
+*************************************************************************/
+/* Shared-memory unwrap transport (Linux).
+
+   The process owning the started Broadkey instance creates a POSIX shared
+   memory region holding a number of slots, each large enough for a key code
+   of BK_KEY_CODE_HEADER_SIZE_BYTES + 1024 bytes and the unwrapped key, and a
+   multi-producer/single-consumer ring of submitted slot numbers. A client
+   claims a slot, writes its key code straight into it and submits it; the
+   owner unwraps from the slot into the same slot, and the client reads the
+   key from there. No data is copied through the kernel.
+
+   Both sides spin briefly before sleeping on a futex, and the other side
+   only issues a wake-up when it sees that the peer went to sleep.
+
+   The region is created with mode 0600, so only processes of the same user
+   can attach. A client that dies while holding a slot leaks that slot until
+   the region is recreated. A client waiting for a result checks every 100 ms
+   that the owner process still exists and still serves, which requires both
+   to run in the same PID namespace.
+
+   A client that dies in the middle of a submission cannot be detected. After
+   bk_shm_stop, bk_shm_serve waits at most one second for such submissions to
+   complete. If the client died after taking a ring cell but before filling
+   it, no later submission is served until the region is recreated: the
+   clients concerned wait until the owner stops. */
+
+/*! \brief Size in bytes of one slot, a multiple of 64 so that slots do not share cache lines.
+*/
+#define BK_SHM_SLOT_SIZE_BYTES         2176
+
+/*! \brief Maximum number of key codes handed to one \ref bk_unwrap_batch call by \ref bk_shm_serve.
+*/
+#define BK_SHM_SERVE_BATCH_SIZE        32
+
+/*! \brief Opaque shared-memory region, as mapped by the owner or a client.
+*/
+typedef struct bk_shm bk_shm_t;
+
+/*! \brief Opaque slot of a shared-memory region.
+*/
+typedef struct bk_shm_slot bk_shm_slot_t;
+
+
+/****************************************************************************
+*                      P U B L I C  I N T E R F A C E                       *
+*****************************************************************************/
+/*! \brief Create a shared-memory region (owner side).
+
+    \param[in] *name POSIX shared memory name, starting with '/'. It must not exist.
+
+    \param[in] slot_count Number of slots, a power of two in [1, 65536]. It bounds the
+                          number of unwraps in flight across all clients.
+
+    \param[out] **shm Pointer to a buffer which will hold the region.
+
+    \returns \ref IID_SUCCESS if success, \ref IID_ERROR_RESOURCES if the region could not
+             be created, otherwise another return code.
+*/
+iid_return_t bk_shm_create(const char     *  const name,
+                           const uint32_t          slot_count,
+                                 bk_shm_t ** const shm);
+
+
+/*! \brief Serve the unwrap requests of a region (owner side).
+
+    \details Unwraps submitted key codes, up to \ref BK_SHM_SERVE_BATCH_SIZE at a time
+             through \ref bk_unwrap_batch, until \ref bk_shm_stop is called. Sleeps when
+             there is no request. Broadkey must be enrolled or started.
+
+    \param[in] *shm The region, as created by \ref bk_shm_create.
+
+    \returns \ref IID_SUCCESS once stopped, otherwise another return code.
+*/
+iid_return_t bk_shm_serve(bk_shm_t * const shm);
+
+
+/*! \brief Make \ref bk_shm_serve return.
+
+    \details Can be called from any thread or process attached to the region. Every
+             request submitted before \ref bk_shm_serve returns is completed, with
+             \ref IID_NOT_ALLOWED if it was not served; later submissions are refused.
+             Submissions still in progress delay the return of \ref bk_shm_serve by at
+             most one second.
+
+    \param[in] *shm The region.
+
+    \returns \ref IID_SUCCESS if success, otherwise another return code.
+*/
+iid_return_t bk_shm_stop(bk_shm_t * const shm);
+
+
+/*! \brief Remove a shared-memory region (owner side).
+
+    \details Unmaps the region and removes its name. Clients still attached keep their
+             mapping but are not served anymore.
+
+    \param[in] *shm The region, as created by \ref bk_shm_create.
+
+    \returns \ref IID_SUCCESS if success, otherwise another return code.
+*/
+iid_return_t bk_shm_destroy(bk_shm_t * const shm);
+
+
+/*! \brief Attach to a shared-memory region (client side).
+
+    \param[in] *name Name given to \ref bk_shm_create.
+
+    \param[out] **shm Pointer to a buffer which will hold the region.
+
+    \returns \ref IID_SUCCESS if success, \ref IID_ERROR_RESOURCES if the region could not be
+             mapped, \ref IID_INVALID_PARAMETERS if it is not a valid region, otherwise
+             another return code.
+*/
+iid_return_t bk_shm_attach(const char     *  const name,
+                                 bk_shm_t ** const shm);
+
+
+/*! \brief Detach from a shared-memory region (client side).
+
+    \param[in] *shm The region, as attached by \ref bk_shm_attach.
+
+    \returns \ref IID_SUCCESS if success, otherwise another return code.
+*/
+iid_return_t bk_shm_detach(bk_shm_t * const shm);
+
+
+/*! \brief Claim a free slot (client side).
+
+    \param[in] *shm The region.
+
+    \param[out] **slot Pointer to a buffer which will hold the slot.
+
+    \param[out] **key_code Pointer to a buffer which will hold the address, inside the slot,
+                           where the key code must be written. It is 32-bit aligned and
+                           has room for \ref BK_KEY_CODE_HEADER_SIZE_BYTES + 1024 bytes.
+
+    \returns \ref IID_SUCCESS if success, \ref IID_ERROR_RESOURCES if every slot is in use,
+             otherwise another return code.
+*/
+iid_return_t bk_shm_acquire(bk_shm_t      *  const shm,
+                            bk_shm_slot_t ** const slot,
+                            uint8_t       ** const key_code);
+
+
+/*! \brief Unwrap the key code of a slot (client side).
+
+    \details Submits the slot to the owner and waits for the result. See \ref bk_unwrap.
+
+    \param[in] *shm The region.
+
+    \param[in] *slot A slot claimed by \ref bk_shm_acquire, holding a key code.
+
+    \param[in] key_code_size The size in bytes of the key code.
+
+    \param[out] **key Pointer to a buffer which will hold the address, inside the slot,
+                      of the unwrapped key. It is valid until \ref bk_shm_release.
+
+    \param[out] *key_length Pointer to a buffer which will contain the size in bytes of the key.
+
+    \param[out] *index Pointer to a byte buffer which will contain the index associated to the key.
+
+    \returns The return code of the unwrap, \ref IID_NOT_ALLOWED if the region is stopped
+             or the owner process exited without completing the request, otherwise
+             another return code. In the last case the slot cannot be released anymore.
+*/
+iid_return_t bk_shm_unwrap(      bk_shm_t      *  const shm,
+                                 bk_shm_slot_t *  const slot,
+                           const uint16_t                key_code_size,
+                           const uint8_t       ** const key,
+                                 uint16_t      *  const key_length,
+                                 uint8_t       *  const index);
+
+
+/*! \brief Zeroize and free a slot (client side).
+
+    \param[in] *shm The region.
+
+    \param[in] *slot A slot claimed by \ref bk_shm_acquire.
+
+    \returns \ref IID_SUCCESS if success, otherwise another return code.
+*/
+iid_return_t bk_shm_release(bk_shm_t      * const shm,
+                            bk_shm_slot_t * const slot);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __IID_BROADKEY_SHM__H__ */
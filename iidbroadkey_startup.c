@@ -0,0 +1,257 @@
+/*
+Copyright (c) 2017, prpl Foundation
+Permission to use, copy, modify, and/or distribute this software for any purpose with or without
+fee is hereby granted, provided that the above copyright notice and this permission notice appear
+in all copies.
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE
+INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE
+FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION,
+ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+#include "iidbroadkey_startup.h"
+#include "iidreturn_codes.h"
+
+/************************************************************************
+*                        D E F I N I T I O N S                          *
+*************************************************************************/
+#define STARTUP_PPM                    UINT64_C(1000000)
+
+/* 99% two-sided normal quantile, scaled by 1000. */
+#define STARTUP_Z99_MILLI              UINT64_C(2576)
+
+/* Number of fractional bits computed by startup_neg_log2. */
+#define STARTUP_LOG2_FRACTION_BITS     16
+
+
+/****************************************************************************
+*                     P R I V A T E  F U N C T I O N S                      *
+*****************************************************************************/
+/* GCC and Clang turn the builtins into POPCNT/TZCNT given a suitable -march. */
+static uint32_t startup_popcount(const uint32_t word)
+{
+#if defined(__GNUC__)
+    return (uint32_t)__builtin_popcount(word);
+#else
+    uint32_t x = word;
+
+    x = x - ((x >> 1) & UINT32_C(0x55555555));
+    x = (x & UINT32_C(0x33333333)) + ((x >> 2) & UINT32_C(0x33333333));
+    x = (x + (x >> 4)) & UINT32_C(0x0F0F0F0F);
+
+    return (x * UINT32_C(0x01010101)) >> 24;
+#endif
+}
+
+/* word must not be zero. */
+static uint32_t startup_ctz(const uint32_t word)
+{
+#if defined(__GNUC__)
+    return (uint32_t)__builtin_ctz(word);
+#else
+    uint32_t n = 0;
+
+    while ((word & (UINT32_C(1) << n)) == 0)
+    {
+        n++;
+    }
+
+    return n;
+#endif
+}
+
+/* Bit count with shifts, masks and adds only, which every SIMD instruction
+   set has; the multiply of the usual form keeps GCC from vectorizing it for
+   AVX2. */
+static uint32_t startup_popcount_vector(uint32_t x)
+{
+    x = x - ((x >> 1) & UINT32_C(0x55555555));
+    x = (x & UINT32_C(0x33333333)) + ((x >> 2) & UINT32_C(0x33333333));
+    x = (x + (x >> 4)) & UINT32_C(0x0F0F0F0F);
+    x = x + (x >> 8);
+    x = x + (x >> 16);
+
+    return x & UINT32_C(0x3F);
+}
+
+/* First pass: number of ones and of run ends, as a branch-free reduction kept
+   apart from the run-length scan so that it vectorizes (checked with GCC -O3
+   for SSE2, AVX2 and AVX-512). Bit j of a word's transitions is set when bit
+   j differs from the bit after it, that is when a run ends at bit j; the
+   last bit of the buffer ends the last run and is not counted. The next word
+   is read through its own pointer, otherwise GCC reuses it as the current
+   word of the following iteration, and that carried value stops the
+   vectorizer. */
+static void startup_count(const uint8_t  * const sram_puf,
+                          const uint32_t         words,
+                                uint32_t * const ones,
+                                uint32_t * const run_ends)
+{
+    const uint8_t * const next_words = &sram_puf[WORD_BYTE];
+    uint32_t              word;
+    uint32_t              next;
+    uint32_t              total_ones = 0;
+    uint32_t              total_ends = 0;
+    uint32_t              i;
+
+    for (i = 0; i < (words - 1); i++)
+    {
+        iid_memcpy(&word, &sram_puf[i * WORD_BYTE], WORD_BYTE);
+        iid_memcpy(&next, &next_words[i * WORD_BYTE], WORD_BYTE);
+        total_ones += startup_popcount_vector(word);
+        total_ends += startup_popcount_vector(word ^ ((word >> 1) | (next << (WORD_BIT - 1))));
+    }
+
+    iid_memcpy(&word, &sram_puf[i * WORD_BYTE], WORD_BYTE);
+    total_ones += startup_popcount(word);
+    total_ends += startup_popcount((word ^ (word >> 1)) & ~(UINT32_C(1) << (WORD_BIT - 1)));
+
+    *ones     = total_ones;
+    *run_ends = total_ends;
+}
+
+static uint64_t startup_isqrt(const uint64_t value)
+{
+    uint64_t rest   = value;
+    uint64_t root   = 0;
+    uint64_t bit    = UINT64_C(1) << 62;
+
+    while (bit > rest)
+    {
+        bit >>= 2;
+    }
+
+    while (bit != 0)
+    {
+        if (rest >= (root + bit))
+        {
+            rest -= root + bit;
+            root  = (root >> 1) + bit;
+        }
+        else
+        {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+
+    return root;
+}
+
+/* Returns -log2(p_ppm / 10^6) in millibits, for p_ppm in [500000, 1000000]. */
+static uint32_t startup_neg_log2_millibits(const uint32_t p_ppm)
+{
+    uint64_t z;
+    uint32_t result = 0;
+    uint32_t i;
+
+    /* z = 1 / p in Q30, in [2^30, 2^31]. */
+    z = (STARTUP_PPM << 30) / p_ppm;
+    if (z >= (UINT64_C(1) << 31))
+    {
+        return 1000;
+    }
+
+    for (i = 1; i <= STARTUP_LOG2_FRACTION_BITS; i++)
+    {
+        z = (z * z) >> 30;
+        if (z >= (UINT64_C(1) << 31))
+        {
+            z >>= 1;
+            result |= UINT32_C(1) << (STARTUP_LOG2_FRACTION_BITS - i);
+        }
+    }
+
+    return (uint32_t)((((uint64_t)result * 1000) + (UINT64_C(1) << (STARTUP_LOG2_FRACTION_BITS - 1)))
+                      >> STARTUP_LOG2_FRACTION_BITS);
+}
+
+
+/****************************************************************************
+*                      P U B L I C  F U N C T I O N S                       *
+*****************************************************************************/
+iid_return_t bk_analyze_startup_data(const uint8_t            * const sram_puf,
+                                     const uint16_t                   sram_puf_size,
+                                           bk_startup_stats_t * const stats)
+{
+    const uint32_t words = sram_puf_size / WORD_BYTE;
+    uint32_t       word;
+    uint32_t       next;
+    uint32_t       transitions;
+    uint32_t       position;
+    uint32_t       run_start = 0;
+    uint32_t       i;
+    uint64_t       p_ppm;
+    uint64_t       bound_ppm;
+
+    if ((sram_puf == NULL) || (stats == NULL) ||
+        ((((uintptr_t)sram_puf) % WORD_BYTE) != 0) ||
+        (sram_puf_size < BK_SRAM_SIZE_BYTES) || ((sram_puf_size % WORD_BYTE) != 0))
+    {
+        return IID_INVALID_PARAMETERS;
+    }
+
+    iid_memset(stats, 0, sizeof(*stats));
+    stats->bits = words * WORD_BIT;
+
+    startup_count(sram_puf, words, &stats->ones, &stats->runs);
+
+    /* Second pass: per-word weights and run lengths, which depend on the
+       data and are scanned word by word. */
+    iid_memcpy(&word, sram_puf, WORD_BYTE);
+
+    for (i = 0; i < words; i++)
+    {
+        stats->word_weight_histogram[startup_popcount(word)]++;
+
+        if ((i + 1) < words)
+        {
+            iid_memcpy(&next, &sram_puf[(i + 1) * WORD_BYTE], WORD_BYTE);
+            transitions = word ^ ((word >> 1) | (next << (WORD_BIT - 1)));
+        }
+        else
+        {
+            next        = 0;
+            transitions = (word ^ (word >> 1)) & ~(UINT32_C(1) << (WORD_BIT - 1));
+        }
+
+        while (transitions != 0)
+        {
+            position = (i * WORD_BIT) + startup_ctz(transitions);
+            if ((position + 1 - run_start) > stats->longest_run)
+            {
+                stats->longest_run = position + 1 - run_start;
+            }
+            run_start    = position + 1;
+            transitions &= transitions - 1;
+        }
+
+        word = next;
+    }
+
+    stats->runs++;
+    if ((stats->bits - run_start) > stats->longest_run)
+    {
+        stats->longest_run = stats->bits - run_start;
+    }
+
+    stats->hamming_weight_ppm = (uint32_t)(((uint64_t)stats->ones * STARTUP_PPM) / stats->bits);
+
+    /* Most common value estimate, NIST SP 800-90B section 6.3.1. */
+    p_ppm = (stats->ones > (stats->bits - stats->ones)) ? stats->hamming_weight_ppm
+                                                        : (STARTUP_PPM - stats->hamming_weight_ppm);
+    bound_ppm = p_ppm + ((STARTUP_Z99_MILLI *
+                          startup_isqrt((p_ppm * (STARTUP_PPM - p_ppm)) / (stats->bits - 1))) / 1000);
+    if (bound_ppm >= STARTUP_PPM)
+    {
+        stats->min_entropy_millibits_per_bit = 0;
+    }
+    else
+    {
+        stats->min_entropy_millibits_per_bit = startup_neg_log2_millibits((uint32_t)bound_ppm);
+    }
+
+    stats->min_entropy_bits = (uint32_t)(((uint64_t)stats->min_entropy_millibits_per_bit * stats->bits) / 1000);
+
+    return IID_SUCCESS;
+}
@@ -0,0 +1,80 @@
+/*
+Copyright (c) 2017, prpl Foundation
+Permission to use, copy, modify, and/or distribute this software for any purpose with or without
+fee is hereby granted, provided that the above copyright notice and this permission notice appear
+in all copies.
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE
+INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE
+FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION,
+ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+#ifndef __IID_BROADKEY_STARTUP__H__
+#define __IID_BROADKEY_STARTUP__H__
+
+#include "iidbroadkey.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/*! \addtogroup StartupAnalysis
+*/
+/*@{*/
+
+/************************************************************************
+*                        D E F I N I T I O N S                          *
+*************************************************************************/
+/*! \brief Statistics of SRAM start-up data, see \ref bk_analyze_startup_data.
+
+    \details Bits are taken in order of increasing significance within each 32-bit
+             word of the buffer. Fractions are expressed in parts per million and
+             entropies in millibits, so that no floating point is needed to produce
+             or to transmit them.
+*/
+typedef struct bk_startup_stats {
+    uint32_t bits;                                  /*!< Number of analyzed bits. */
+    uint32_t ones;                                  /*!< Number of bits set to one. */
+    uint32_t hamming_weight_ppm;                    /*!< Fractional Hamming weight, ones / bits. */
+    uint16_t word_weight_histogram[WORD_BIT + 1];   /*!< Number of 32-bit words per Hamming weight. */
+    uint32_t runs;                                  /*!< Number of runs of identical bits. */
+    uint32_t longest_run;                           /*!< Length in bits of the longest run. */
+    uint32_t min_entropy_millibits_per_bit;         /*!< Min-entropy estimate per bit, in [0, 1000]. */
+    uint32_t min_entropy_bits;                      /*!< Min-entropy estimate of the whole buffer. */
+} bk_startup_stats_t;
+
+
+/****************************************************************************
+*                      P U B L I C  I N T E R F A C E                       *
+*****************************************************************************/
+/*! \brief Analyze the quality of SRAM start-up data.
+
+    \details Computes statistics on the start-up data of the SRAM that would be given
+             to \ref bk_init, for instance to screen devices or to report the quality
+             of the SRAM PUF at every boot. The data is only read.
+             The min-entropy estimate is the most-common-value estimate of NIST
+             SP 800-90B: -log2 of the upper 99% confidence bound on the probability of
+             the most frequent bit value.
+
+    \param[in] *sram_puf Pointer to the start-up data, as for \ref bk_init.
+                         Its address must be aligned to 32 bits.
+
+    \param[in] sram_puf_size The size in bytes of \ref sram_puf. It must be of at least
+                             \ref BK_SRAM_SIZE_BYTES and a multiple of 4.
+
+    \param[out] *stats Pointer to a structure which will hold the statistics.
+
+    \returns \ref IID_SUCCESS if success, otherwise another return code.
+*/
+iid_return_t bk_analyze_startup_data(const uint8_t            * const sram_puf,
+                                     const uint16_t                   sram_puf_size,
+                                           bk_startup_stats_t * const stats);
+
+/*@}*/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __IID_BROADKEY_STARTUP__H__ */
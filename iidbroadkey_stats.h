@@ -0,0 +1,127 @@
+/*
+Copyright (c) 2017, prpl Foundation
+Permission to use, copy, modify, and/or distribute this software for any purpose with or without
+fee is hereby granted, provided that the above copyright notice and this permission notice appear
+in all copies.
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE
+INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE
+FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION,
+ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+#ifndef __IID_BROADKEY_STATS__H__
+#define __IID_BROADKEY_STATS__H__
+
+#include "iidbroadkey.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/************************************************************************
+*                        D E F I N I T I O N S                          *
+*************************************************************************/
+/*! \brief Number of latency buckets. Bucket i counts the calls that took
+           [2^i, 2^(i+1)) nanoseconds; bucket 0 also counts calls under 1 ns
+           and the last bucket all longer calls.
+*/
+#define BK_STATS_LATENCY_BUCKETS       32
+
+/*! \brief Number of key length buckets of \ref bk_wrap and \ref bk_unwrap.
+           Bucket i counts key lengths in [2^(i+2), 2^(i+3)), so that the last
+           bucket only holds 1024-byte keys.
+*/
+#define BK_STATS_LENGTH_BUCKETS        9
+
+/*! \brief Defines the return codes counted separately in \ref bk_op_stats_t.
+*/
+typedef enum bk_stats_result {
+    BK_STATS_SUCCESS               = 0, /*!< \ref IID_SUCCESS */
+    BK_STATS_NOT_ALLOWED           = 1, /*!< \ref IID_NOT_ALLOWED */
+    BK_STATS_INVALID_PARAMETERS    = 2, /*!< \ref IID_INVALID_PARAMETERS */
+    BK_STATS_ERROR_STARTUP_DATA    = 3, /*!< \ref IID_ERROR_STARTUP_DATA */
+    BK_STATS_INVALID_AC            = 4, /*!< \ref IID_INVALID_AC */
+    BK_STATS_INVALID_KEY_CODE      = 5, /*!< \ref IID_INVALID_KEY_CODE */
+    BK_STATS_OTHER                 = 6, /*!< Any other return code. */
+    BK_STATS_RESULTS               = 7  /*!< Number of counted return codes. */
+} bk_stats_result_t;
+
+/*! \brief Defines the operations counted separately in \ref bk_stats_t.
+
+    \details \ref bk_get_key is counted per \ref key_type_t, in the order of that
+             enumeration. \ref bk_wrap and \ref bk_unwrap are counted per key length
+             bucket, see \ref BK_STATS_LENGTH_BUCKETS. Every item of a batch call is
+             counted in the operation of the matching single call, with the latency of
+             the batch divided by its number of items.
+*/
+typedef enum bk_stats_op {
+    BK_STATS_OP_INIT               = 0,
+    BK_STATS_OP_ENROLL             = 1,
+    BK_STATS_OP_START              = 2,
+    BK_STATS_OP_STOP               = 3,
+    BK_STATS_OP_GET_KEY            = 4,  /*!< First of 8 \ref bk_get_key operations. */
+    BK_STATS_OP_WRAP               = 12, /*!< First of \ref BK_STATS_LENGTH_BUCKETS \ref bk_wrap operations. */
+    BK_STATS_OP_UNWRAP             = 21, /*!< First of \ref BK_STATS_LENGTH_BUCKETS \ref bk_unwrap operations. */
+    BK_STATS_OPS                   = 30  /*!< Number of counted operations. */
+} bk_stats_op_t;
+
+/*! \brief Statistics of one operation.
+*/
+typedef struct bk_op_stats {
+    uint64_t calls;                                 /*!< Number of calls. */
+    uint64_t results[BK_STATS_RESULTS];             /*!< Number of calls per return code. */
+    uint64_t latency[BK_STATS_LATENCY_BUCKETS];     /*!< Number of calls per latency bucket. */
+} bk_op_stats_t;
+
+/*! \brief Snapshot of the statistics of all operations, see \ref bk_get_stats.
+*/
+typedef struct bk_stats {
+    bk_op_stats_t ops[BK_STATS_OPS];                /*!< Indexed by \ref bk_stats_op_t. */
+} bk_stats_t;
+
+
+/****************************************************************************
+*                      P U B L I C  I N T E R F A C E                       *
+*****************************************************************************/
+/*! \brief Get a snapshot of the call statistics.
+
+    \details Counters are kept per thread, so that counting never makes threads
+             contend, and are summed by this function. The snapshot is consistent
+             per counter but not across counters updated while it is taken.
+             Statistics are only collected when the library is built with them.
+
+    \param[out] *stats Pointer to a structure which will hold the snapshot.
+
+    \returns \ref IID_SUCCESS if success, \ref IID_NOT_ALLOWED if statistics are not
+             collected, otherwise another return code.
+*/
+iid_return_t bk_get_stats(bk_stats_t * const stats);
+
+
+/*! \brief Reset the call statistics.
+
+    \details Sets every counter to zero. Calls in progress may still be counted
+             in the previous period.
+
+    \returns \ref IID_SUCCESS if success, \ref IID_NOT_ALLOWED if statistics are not
+             collected, otherwise another return code.
+*/
+iid_return_t bk_reset_stats(void);
+
+
+/*! \brief Get a snapshot of the call statistics of a context. See \ref bk_get_stats.
+*/
+iid_return_t bk_ctx_get_stats(bk_ctx_t   * const ctx,
+                              bk_stats_t * const stats);
+
+
+/*! \brief Reset the call statistics of a context. See \ref bk_reset_stats.
+*/
+iid_return_t bk_ctx_reset_stats(bk_ctx_t * const ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __IID_BROADKEY_STATS__H__ */
@@ -0,0 +1,447 @@
+/*
+Copyright (c) 2017, prpl Foundation
+Permission to use, copy, modify, and/or distribute this software for any purpose with or without
+fee is hereby granted, provided that the above copyright notice and this permission notice appear
+in all copies.
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE
+INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE
+FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION,
+ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+#define _POSIX_C_SOURCE 200809L
+#define _FILE_OFFSET_BITS 64
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "iidbroadkey_store.h"
+#include "iidreturn_codes.h"
+
+/************************************************************************
+*                        D E F I N I T I O N S                          *
+*************************************************************************/
+#define STORE_MAGIC                    "BKST"
+#define STORE_INDEX_ALIGNMENT          8
+
+typedef struct store_entry {
+    uint64_t device_id;
+    uint64_t offset;
+    uint32_t key;
+    uint16_t length;
+    uint16_t kind;
+} store_entry_t;
+
+struct bk_store_writer {
+    FILE          * file;
+    uint64_t        offset;
+    store_entry_t * entries;
+    uint64_t        count;
+    uint64_t        capacity;
+    bool            failed;
+};
+
+struct bk_store {
+    const uint8_t * base;
+    size_t          size;
+    const uint8_t * index;
+    uint64_t        mask;
+};
+
+
+/****************************************************************************
+*                     P R I V A T E  F U N C T I O N S                      *
+*****************************************************************************/
+/* Payload lengths bk_start and bk_unwrap accept for each kind of record. */
+static bool store_length_valid(const bk_store_kind_t kind,
+                               const uint16_t        length)
+{
+    switch (kind)
+    {
+        case BK_STORE_ACTIVATION_CODE:
+            return length == BK_AC_SIZE_BYTES;
+        case BK_STORE_KEY_CODE:
+            return (length >= (BK_KEY_CODE_HEADER_SIZE_BYTES + WORD_BYTE)) &&
+                   (length <= (BK_KEY_CODE_HEADER_SIZE_BYTES + 1024)) &&
+                   ((length % WORD_BYTE) == 0);
+        default:
+            return false;
+    }
+}
+
+static void store_put16(uint8_t * const p, const uint16_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static void store_put32(uint8_t * const p, const uint32_t v)
+{
+    store_put16(p, (uint16_t)v);
+    store_put16(&p[2], (uint16_t)(v >> 16));
+}
+
+static void store_put64(uint8_t * const p, const uint64_t v)
+{
+    store_put32(p, (uint32_t)v);
+    store_put32(&p[4], (uint32_t)(v >> 32));
+}
+
+static uint16_t store_get16(const uint8_t * const p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t store_get32(const uint8_t * const p)
+{
+    return (uint32_t)store_get16(p) | ((uint32_t)store_get16(&p[2]) << 16);
+}
+
+static uint64_t store_get64(const uint8_t * const p)
+{
+    return (uint64_t)store_get32(p) | ((uint64_t)store_get32(&p[4]) << 32);
+}
+
+static uint64_t store_hash(const uint16_t kind,
+                           const uint64_t device_id,
+                           const uint32_t key)
+{
+    uint64_t z = device_id ^ (((uint64_t)key << 16) | kind) * UINT64_C(0x9E3779B97F4A7C15);
+
+    z = (z ^ (z >> 30)) * UINT64_C(0xBF58476D1CE4E5B9);
+    z = (z ^ (z >> 27)) * UINT64_C(0x94D049BB133111EB);
+
+    return z ^ (z >> 31);
+}
+
+static bool store_write(      bk_store_writer_t * const writer,
+                        const void              * const data,
+                        const size_t                    length)
+{
+    if (!writer->failed && (fwrite(data, 1, length, writer->file) != length))
+    {
+        writer->failed = true;
+    }
+    writer->offset += length;
+
+    return !writer->failed;
+}
+
+static bool store_pad(      bk_store_writer_t * const writer,
+                      const uint64_t                  alignment)
+{
+    static const uint8_t zeros[STORE_INDEX_ALIGNMENT] = { 0 };
+
+    return store_write(writer, zeros, (size_t)((alignment - (writer->offset % alignment)) % alignment));
+}
+
+static void store_release(bk_store_writer_t * const writer)
+{
+    if (writer->file != NULL)
+    {
+        fclose(writer->file);
+    }
+    free(writer->entries);
+    free(writer);
+}
+
+
+/****************************************************************************
+*                      P U B L I C  F U N C T I O N S                       *
+*****************************************************************************/
+iid_return_t bk_store_create(const char              *  const path,
+                                   bk_store_writer_t ** const writer)
+{
+    uint8_t             header[BK_STORE_HEADER_SIZE_BYTES];
+    bk_store_writer_t * created;
+
+    if ((path == NULL) || (writer == NULL))
+    {
+        return IID_INVALID_PARAMETERS;
+    }
+
+    created = (bk_store_writer_t *)calloc(1, sizeof(*created));
+    if (created == NULL)
+    {
+        return IID_ERROR_RESOURCES;
+    }
+
+    created->file = fopen(path, "wb");
+    if (created->file == NULL)
+    {
+        store_release(created);
+        return IID_ERROR_RESOURCES;
+    }
+
+    /* The header is rewritten by bk_store_finish. */
+    iid_memset(header, 0, sizeof(header));
+    if (!store_write(created, header, sizeof(header)))
+    {
+        store_release(created);
+        return IID_ERROR_RESOURCES;
+    }
+
+    *writer = created;
+
+    return IID_SUCCESS;
+}
+
+iid_return_t bk_store_add(      bk_store_writer_t * const writer,
+                          const bk_store_kind_t           kind,
+                          const uint64_t                  device_id,
+                          const uint32_t                  key,
+                          const uint8_t           * const data,
+                          const uint16_t                  length)
+{
+    store_entry_t * entries;
+    uint64_t        capacity;
+
+    if ((writer == NULL) || (data == NULL) || !store_length_valid(kind, length) ||
+        ((kind == BK_STORE_ACTIVATION_CODE) && (key != 0)))
+    {
+        return IID_INVALID_PARAMETERS;
+    }
+
+    if (writer->count == writer->capacity)
+    {
+        capacity = (writer->capacity == 0) ? 1024 : (writer->capacity * 2);
+        entries  = (store_entry_t *)realloc(writer->entries, (size_t)capacity * sizeof(store_entry_t));
+        if (entries == NULL)
+        {
+            return IID_ERROR_RESOURCES;
+        }
+        writer->entries  = entries;
+        writer->capacity = capacity;
+    }
+
+    if (!store_pad(writer, WORD_BYTE))
+    {
+        return IID_ERROR_RESOURCES;
+    }
+
+    writer->entries[writer->count].device_id = device_id;
+    writer->entries[writer->count].offset    = writer->offset;
+    writer->entries[writer->count].key       = key;
+    writer->entries[writer->count].length    = length;
+    writer->entries[writer->count].kind      = (uint16_t)kind;
+
+    if (!store_write(writer, data, length))
+    {
+        return IID_ERROR_RESOURCES;
+    }
+
+    writer->count++;
+
+    return IID_SUCCESS;
+}
+
+iid_return_t bk_store_finish(bk_store_writer_t * const writer)
+{
+    uint8_t         header[BK_STORE_HEADER_SIZE_BYTES];
+    uint8_t       * index;
+    uint8_t       * slot;
+    uint64_t        slots = 2;
+    uint64_t        index_offset;
+    uint64_t        i;
+    uint64_t        s;
+    store_entry_t * entry;
+    iid_return_t    rc = IID_SUCCESS;
+
+    if (writer == NULL)
+    {
+        return IID_INVALID_PARAMETERS;
+    }
+
+    while (slots < (writer->count * 2))
+    {
+        slots *= 2;
+    }
+
+    index = (uint8_t *)calloc((size_t)slots, BK_STORE_SLOT_SIZE_BYTES);
+    if (index == NULL)
+    {
+        store_release(writer);
+        return IID_ERROR_RESOURCES;
+    }
+
+    for (i = 0; (i < writer->count) && (rc == IID_SUCCESS); i++)
+    {
+        entry = &writer->entries[i];
+        for (s = store_hash(entry->kind, entry->device_id, entry->key) & (slots - 1); ; s = (s + 1) & (slots - 1))
+        {
+            slot = &index[s * BK_STORE_SLOT_SIZE_BYTES];
+            if (store_get64(&slot[8]) == 0)
+            {
+                store_put64(slot, entry->device_id);
+                store_put64(&slot[8], entry->offset);
+                store_put32(&slot[16], entry->key);
+                store_put16(&slot[20], entry->length);
+                store_put16(&slot[22], entry->kind);
+                break;
+            }
+            if ((store_get64(slot) == entry->device_id) && (store_get32(&slot[16]) == entry->key) &&
+                (store_get16(&slot[22]) == entry->kind))
+            {
+                rc = IID_INVALID_PARAMETERS;
+                break;
+            }
+        }
+    }
+
+    if (rc == IID_SUCCESS)
+    {
+        (void)store_pad(writer, STORE_INDEX_ALIGNMENT);
+        index_offset = writer->offset;
+        (void)store_write(writer, index, (size_t)(slots * BK_STORE_SLOT_SIZE_BYTES));
+
+        iid_memset(header, 0, sizeof(header));
+        iid_memcpy(header, STORE_MAGIC, 4);
+        store_put16(&header[4], BK_STORE_VERSION);
+        store_put64(&header[8], writer->count);
+        store_put64(&header[16], index_offset);
+        store_put64(&header[24], slots);
+
+        if (writer->failed || (fseeko(writer->file, 0, SEEK_SET) != 0) ||
+            (fwrite(header, 1, sizeof(header), writer->file) != sizeof(header)) ||
+            (fflush(writer->file) != 0))
+        {
+            rc = IID_ERROR_RESOURCES;
+        }
+    }
+
+    free(index);
+    store_release(writer);
+
+    return rc;
+}
+
+iid_return_t bk_store_open(const char       *  const path,
+                                 bk_store_t ** const store)
+{
+    struct stat   st;
+    bk_store_t  * opened;
+    void        * base;
+    uint64_t      index_offset;
+    uint64_t      slots;
+    int           fd;
+
+    if ((path == NULL) || (store == NULL))
+    {
+        return IID_INVALID_PARAMETERS;
+    }
+
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return IID_ERROR_RESOURCES;
+    }
+
+    if ((fstat(fd, &st) != 0) || (st.st_size < BK_STORE_HEADER_SIZE_BYTES))
+    {
+        close(fd);
+        return IID_INVALID_PARAMETERS;
+    }
+
+    base = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED)
+    {
+        return IID_ERROR_RESOURCES;
+    }
+
+    index_offset = store_get64(&((const uint8_t *)base)[16]);
+    slots        = store_get64(&((const uint8_t *)base)[24]);
+
+    if ((iid_memcmp(base, STORE_MAGIC, 4) != 0) ||
+        (store_get16(&((const uint8_t *)base)[4]) != BK_STORE_VERSION) ||
+        (slots == 0) || ((slots & (slots - 1)) != 0) ||
+        (index_offset < BK_STORE_HEADER_SIZE_BYTES) || ((index_offset % STORE_INDEX_ALIGNMENT) != 0) ||
+        (slots > (((uint64_t)st.st_size - index_offset) / BK_STORE_SLOT_SIZE_BYTES)) ||
+        (index_offset > (uint64_t)st.st_size))
+    {
+        munmap(base, (size_t)st.st_size);
+        return IID_INVALID_PARAMETERS;
+    }
+
+    opened = (bk_store_t *)calloc(1, sizeof(*opened));
+    if (opened == NULL)
+    {
+        munmap(base, (size_t)st.st_size);
+        return IID_ERROR_RESOURCES;
+    }
+
+    opened->base  = (const uint8_t *)base;
+    opened->size  = (size_t)st.st_size;
+    opened->index = &opened->base[index_offset];
+    opened->mask  = slots - 1;
+
+    *store = opened;
+
+    return IID_SUCCESS;
+}
+
+iid_return_t bk_store_lookup(const bk_store_t      *  const store,
+                             const bk_store_kind_t           kind,
+                             const uint64_t                  device_id,
+                             const uint32_t                  key,
+                             const uint8_t         ** const data,
+                                   uint16_t        *  const length)
+{
+    const uint8_t * slot;
+    uint64_t        offset;
+    uint64_t        s;
+    uint64_t        probes;
+
+    if ((store == NULL) || (data == NULL) || (length == NULL))
+    {
+        return IID_INVALID_PARAMETERS;
+    }
+
+    s = store_hash((uint16_t)kind, device_id, key) & store->mask;
+    for (probes = 0; probes <= store->mask; probes++, s = (s + 1) & store->mask)
+    {
+        slot   = &store->index[s * BK_STORE_SLOT_SIZE_BYTES];
+        offset = store_get64(&slot[8]);
+        if (offset == 0)
+        {
+            break;
+        }
+        if ((store_get64(slot) == device_id) && (store_get32(&slot[16]) == key) &&
+            (store_get16(&slot[22]) == (uint16_t)kind))
+        {
+            /* Records lie between the header and the index. */
+            if (((offset % WORD_BYTE) != 0) || (offset < BK_STORE_HEADER_SIZE_BYTES) ||
+                ((offset + store_get16(&slot[20])) > (uint64_t)(store->index - store->base)))
+            {
+                return IID_INVALID_PARAMETERS;
+            }
+            /* A record bk_store_add could not have written is not handed out. */
+            if (!store_length_valid(kind, store_get16(&slot[20])))
+            {
+                return IID_NOT_FOUND;
+            }
+            *data   = &store->base[offset];
+            *length = store_get16(&slot[20]);
+            return IID_SUCCESS;
+        }
+    }
+
+    return IID_NOT_FOUND;
+}
+
+iid_return_t bk_store_close(bk_store_t * const store)
+{
+    if (store == NULL)
+    {
+        return IID_INVALID_PARAMETERS;
+    }
+
+    munmap((void *)store->base, store->size);
+    free(store);
+
+    return IID_SUCCESS;
+}
@@ -0,0 +1,185 @@
+/*
+Copyright (c) 2017, prpl Foundation
+Permission to use, copy, modify, and/or distribute this software for any purpose with or without
+fee is hereby granted, provided that the above copyright notice and this permission notice appear
+in all copies.
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE
+INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE
+FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION,
+ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+#ifndef __IID_BROADKEY_STORE__H__
+#define __IID_BROADKEY_STORE__H__
+
+#include "iidbroadkey.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/************************************************************************
+*                        D E F I N I T I O N S                          *
+*************************************************************************/
+/* Store file format, all integers little-endian:
+
+     header    BK_STORE_HEADER_SIZE_BYTES bytes
+                 0  magic "BKST"
+                 4  uint16 version (BK_STORE_VERSION)
+                 6  uint16 reserved, 0
+                 8  uint64 number of records
+                16  uint64 offset of the index
+                24  uint64 number of index slots, a power of two
+                32  reserved up to the end of the header, 0
+     records   payloads, each starting at a 32-bit aligned offset
+     index     open-addressing hash table with linear probing, slots of
+               BK_STORE_SLOT_SIZE_BYTES bytes
+                 0  uint64 device identifier
+                 8  uint64 offset of the payload, 0 for an empty slot
+                16  uint32 key
+                20  uint16 length of the payload in bytes
+                22  uint16 kind, see bk_store_kind_t
+
+   The index is at most half full, so a lookup reads one or two slots on
+   average whatever the number of records. */
+
+#define BK_STORE_VERSION               1
+#define BK_STORE_HEADER_SIZE_BYTES     64
+#define BK_STORE_SLOT_SIZE_BYTES       24
+
+/*! \brief Defines the kinds of records of a store.
+*/
+typedef enum bk_store_kind {
+    BK_STORE_ACTIVATION_CODE       = 0x0001, /*!< Activation code of \ref BK_AC_SIZE_BYTES bytes; the key is 0. */
+    BK_STORE_KEY_CODE              = 0x0002  /*!< Key code generated by \ref bk_wrap. */
+} bk_store_kind_t;
+
+/*! \brief Opaque store opened for reading.
+*/
+typedef struct bk_store bk_store_t;
+
+/*! \brief Opaque store being written.
+*/
+typedef struct bk_store_writer bk_store_writer_t;
+
+
+/****************************************************************************
+*                      P U B L I C  I N T E R F A C E                       *
+*****************************************************************************/
+/*! \brief Create a store file.
+
+    \details Creates or truncates the file. Records are appended with
+             \ref bk_store_add and the index is written by \ref bk_store_finish.
+
+    \param[in] *path Path of the file.
+
+    \param[out] **writer Pointer to a buffer which will hold the writer.
+
+    \returns \ref IID_SUCCESS if success, \ref IID_ERROR_RESOURCES if the file or memory
+             could not be obtained, otherwise another return code.
+*/
+iid_return_t bk_store_create(const char              *  const path,
+                                   bk_store_writer_t ** const writer);
+
+
+/*! \brief Append a record to a store.
+
+    \param[in] *writer The writer.
+
+    \param[in] kind Kind of the record, one of the values enumerated in \ref bk_store_kind_t.
+
+    \param[in] device_id Identifier of the device the record belongs to.
+
+    \param[in] key Identifies the record among the records of the same kind and device,
+                   for instance the index of the key code. Must be 0 for activation codes.
+
+    \param[in] *data Pointer to the payload.
+
+    \param[in] length Length in bytes of \ref data. It must be \ref BK_AC_SIZE_BYTES for an
+                      activation code. For a key code it must be a multiple of 4 in the
+                      [\ref BK_KEY_CODE_HEADER_SIZE_BYTES + 4,
+                      \ref BK_KEY_CODE_HEADER_SIZE_BYTES + 1024] range.
+
+    \returns \ref IID_SUCCESS if success, \ref IID_INVALID_PARAMETERS if \ref length does
+             not match \ref kind, otherwise another return code.
+*/
+iid_return_t bk_store_add(      bk_store_writer_t * const writer,
+                          const bk_store_kind_t           kind,
+                          const uint64_t                  device_id,
+                          const uint32_t                  key,
+                          const uint8_t           * const data,
+                          const uint16_t                  length);
+
+
+/*! \brief Write the index and close a store being written.
+
+    \details The writer is released whatever the result.
+
+    \param[in] *writer The writer.
+
+    \returns \ref IID_SUCCESS if success, \ref IID_INVALID_PARAMETERS if two records have
+             the same kind, device identifier and key, otherwise another return code.
+*/
+iid_return_t bk_store_finish(bk_store_writer_t * const writer);
+
+
+/*! \brief Open a store for reading.
+
+    \details Maps the file in memory read-only. Records are read in place.
+
+    \param[in] *path Path of the file.
+
+    \param[out] **store Pointer to a buffer which will hold the store.
+
+    \returns \ref IID_SUCCESS if success, \ref IID_INVALID_PARAMETERS if the file is not a
+             valid store, \ref IID_ERROR_RESOURCES if it could not be opened or mapped,
+             otherwise another return code.
+*/
+iid_return_t bk_store_open(const char       *  const path,
+                                 bk_store_t ** const store);
+
+
+/*! \brief Look up a record.
+
+    \details Returns a pointer to the payload inside the mapping, without copying it.
+             The payload is 32-bit aligned, so it can be passed directly to
+             \ref bk_start or \ref bk_unwrap. It stays valid until \ref bk_store_close.
+
+    \param[in] *store The store.
+
+    \param[in] kind Kind of the record.
+
+    \param[in] device_id Identifier of the device.
+
+    \param[in] key Key of the record, see \ref bk_store_add.
+
+    \param[out] **data Pointer to a buffer which will hold the address of the payload.
+
+    \param[out] *length Pointer to a buffer which will hold the length of the payload in bytes.
+
+    \returns \ref IID_SUCCESS if success, \ref IID_NOT_FOUND if there is no such record or
+             its length is not valid for its kind, as checked by \ref bk_store_add,
+             otherwise another return code.
+*/
+iid_return_t bk_store_lookup(const bk_store_t      *  const store,
+                             const bk_store_kind_t           kind,
+                             const uint64_t                  device_id,
+                             const uint32_t                  key,
+                             const uint8_t         ** const data,
+                                   uint16_t        *  const length);
+
+
+/*! \brief Close a store opened for reading.
+
+    \param[in] *store The store.
+
+    \returns \ref IID_SUCCESS if success, otherwise another return code.
+*/
+iid_return_t bk_store_close(bk_store_t * const store);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __IID_BROADKEY_STORE__H__ */
@@ -0,0 +1,86 @@
+/*
+Copyright (c) 2017, prpl Foundation
+Permission to use, copy, modify, and/or distribute this software for any purpose with or without
+fee is hereby granted, provided that the above copyright notice and this permission notice appear
+in all copies.
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE
+INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE
+FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION,
+ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+#define _POSIX_C_SOURCE 200809L
+
+#include <stddef.h>
+#include <pthread.h>
+
+#include "iidbroadkey_trace_private.h"
+
+/************************************************************************
+*                        D E F I N I T I O N S                          *
+*************************************************************************/
+/* The callback and its user data are replaced together under the write lock.
+   Dispatch holds the read lock during the call, so once bk_set_trace_callback
+   returns the previous callback has finished. */
+static pthread_rwlock_t      trace_lock = PTHREAD_RWLOCK_INITIALIZER;
+static bk_trace_callback_t   trace_callback;
+static void                * trace_user_data;
+
+int bk_trace_installed;
+
+
+/****************************************************************************
+*                      P U B L I C  F U N C T I O N S                       *
+*****************************************************************************/
+iid_return_t bk_set_trace_callback(const bk_trace_callback_t         callback,
+                                         void                * const user_data)
+{
+#if IID_BK_TRACE == 1
+    if (pthread_rwlock_wrlock(&trace_lock) != 0)
+    {
+        return IID_ERROR_RESOURCES;
+    }
+
+    trace_callback  = callback;
+    trace_user_data = user_data;
+    __atomic_store_n(&bk_trace_installed, callback != NULL, __ATOMIC_RELAXED);
+
+    (void)pthread_rwlock_unlock(&trace_lock);
+
+    return IID_SUCCESS;
+#else
+    (void)callback;
+    (void)user_data;
+
+    return IID_NOT_ALLOWED;
+#endif
+}
+
+void bk_trace_dispatch(const char             * const name,
+                       const bk_trace_point_t         point,
+                       const uint32_t                 key_type,
+                       const uint32_t                 index,
+                       const uint32_t                 length,
+                       const iid_return_t             rc)
+{
+    bk_trace_event_t event;
+
+    if (pthread_rwlock_rdlock(&trace_lock) != 0)
+    {
+        return;
+    }
+
+    if (trace_callback != NULL)
+    {
+        event.name     = name;
+        event.point    = point;
+        event.key_type = key_type;
+        event.index    = index;
+        event.length   = length;
+        event.rc       = rc;
+
+        trace_callback(&event, trace_user_data);
+    }
+
+    (void)pthread_rwlock_unlock(&trace_lock);
+}
@@ -0,0 +1,104 @@
+/*
+Copyright (c) 2017, prpl Foundation
+Permission to use, copy, modify, and/or distribute this software for any purpose with or without
+fee is hereby granted, provided that the above copyright notice and this permission notice appear
+in all copies.
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE
+INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE
+FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION,
+ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+#ifndef __IID_BROADKEY_TRACE__H__
+#define __IID_BROADKEY_TRACE__H__
+
+#include "iidbroadkey.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/************************************************************************
+*                        D E F I N I T I O N S                          *
+*************************************************************************/
+/* USDT probes.
+
+   When the library is built with IID_BK_TRACE set to 1 on a platform that
+   provides <sys/sdt.h>, every function of iidbroadkey.h has an entry and an
+   exit probe of provider "broadkey", named after the function without its
+   bk_ prefix, for instance broadkey:get_key_entry and broadkey:get_key_exit.
+   They can be attached to with perf or bpftrace, without rebuilding.
+
+   Entry probes carry the arguments below, exit probes carry the same
+   arguments followed by the return code. Arguments that do not apply to a
+   function are 0. Key material, activation codes and key codes are never
+   passed to a probe.
+     arg0  key_type   (bk_get_key)
+     arg1  index      (bk_get_key, bk_wrap; bk_unwrap on exit)
+     arg2  length     (key length of bk_wrap and bk_unwrap, item count of batch calls)
+
+   bk_start has additional probes around its internal phases:
+     broadkey:start_check_entry/exit        activation code checks
+     broadkey:start_decode_entry/exit       helper-data error correction
+     broadkey:start_reconstruct_entry/exit  intrinsic key and keyed state derivation
+
+   The implementation fires them through iidbroadkey_trace_private.h, which
+   also dispatches every probe to the callback of bk_set_trace_callback. This
+   header does not depend on <sys/sdt.h>. */
+
+/*! \brief Defines the events reported to a \ref bk_trace_callback_t.
+*/
+typedef enum bk_trace_point {
+    BK_TRACE_ENTRY_POINT           = 0x00, /*!< Entry of a function or phase. */
+    BK_TRACE_EXIT_POINT            = 0x01  /*!< Exit of a function or phase. */
+} bk_trace_point_t;
+
+/*! \brief Event reported to a \ref bk_trace_callback_t.
+
+    \details Carries the same information as the USDT probes.
+*/
+typedef struct bk_trace_event {
+    const char         * name;      /*!< Probe name without _entry/_exit, e.g. "get_key". */
+    bk_trace_point_t     point;     /*!< Entry or exit. */
+    uint32_t             key_type;  /*!< See the arguments of the USDT probes. */
+    uint32_t             index;     /*!< See the arguments of the USDT probes. */
+    uint32_t             length;    /*!< See the arguments of the USDT probes. */
+    iid_return_t         rc;        /*!< Return code, only valid on exit. */
+} bk_trace_event_t;
+
+/*! \brief Trace callback, see \ref bk_set_trace_callback.
+
+    \details It is called synchronously, on the thread making the traced call, and
+             must not call Broadkey functions. The event is only valid during the call.
+*/
+typedef void (*bk_trace_callback_t)(const bk_trace_event_t * const event,
+                                          void             * const user_data);
+
+
+/****************************************************************************
+*                      P U B L I C  I N T E R F A C E                       *
+*****************************************************************************/
+/*! \brief Install a trace callback.
+
+    \details The callback is called at every trace point, whether or not a tracer
+             is attached and whether or not the platform provides USDT probes. When
+             no callback is installed the cost of a trace point is one predicted
+             branch. Once this function returns, the previous callback is no longer
+             running and will not be called again.
+
+    \param[in] callback The function to call, or NULL to remove the callback.
+
+    \param[in] *user_data Value passed to every call of \ref callback.
+
+    \returns \ref IID_SUCCESS if success, \ref IID_NOT_ALLOWED if the library was
+             built with \ref IID_BK_TRACE set to 0, otherwise another return code.
+*/
+iid_return_t bk_set_trace_callback(const bk_trace_callback_t         callback,
+                                         void                * const user_data);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __IID_BROADKEY_TRACE__H__ */
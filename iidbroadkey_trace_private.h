@@ -0,0 +1,108 @@
+/*
+Copyright (c) 2017, prpl Foundation
+Permission to use, copy, modify, and/or distribute this software for any purpose with or without
+fee is hereby granted, provided that the above copyright notice and this permission notice appear
+in all copies.
+THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE
+INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE
+FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION,
+ARISING OUT OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+#ifndef __IID_BROADKEY_TRACE_PRIVATE__H__
+#define __IID_BROADKEY_TRACE_PRIVATE__H__
+
+/* Trace points of the library implementation. Not installed with the public
+   headers: it is the only place that includes <sys/sdt.h>. */
+
+#include "iidbroadkey_trace.h"
+#include "iidreturn_codes.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/************************************************************************
+*                        D E F I N I T I O N S                          *
+*************************************************************************/
+#if (IID_BK_TRACE == 1) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define BK_TRACE_HAS_USDT              1
+#endif
+#endif
+
+#ifndef BK_TRACE_HAS_USDT
+#define BK_TRACE_HAS_USDT              0
+#endif
+
+#if BK_TRACE_HAS_USDT == 1
+#define BK_TRACE_USDT_ENTRY(name, key_type, index, length) \
+    DTRACE_PROBE3(broadkey, name##_entry, (key_type), (index), (length))
+#define BK_TRACE_USDT_EXIT(name, key_type, index, length, rc) \
+    DTRACE_PROBE4(broadkey, name##_exit, (key_type), (index), (length), (rc))
+#else
+#define BK_TRACE_USDT_ENTRY(name, key_type, index, length)      ((void)0)
+#define BK_TRACE_USDT_EXIT(name, key_type, index, length, rc)   ((void)0)
+#endif
+
+#if IID_BK_TRACE == 1
+/*! \brief Non-zero while a trace callback is installed. Only read by the macros below.
+*/
+extern int bk_trace_installed;
+
+/*! \brief Fires an entry probe and calls the trace callback, if any.
+*/
+#define BK_TRACE_ENTRY(name, key_type, index, length)                                    \
+    do {                                                                                 \
+        BK_TRACE_USDT_ENTRY(name, key_type, index, length);                              \
+        if (__builtin_expect(__atomic_load_n(&bk_trace_installed, __ATOMIC_RELAXED), 0)) \
+        {                                                                                \
+            bk_trace_dispatch(#name, BK_TRACE_ENTRY_POINT,                               \
+                              (key_type), (index), (length), IID_SUCCESS);               \
+        }                                                                                \
+    } while (0)
+
+/*! \brief Fires an exit probe and calls the trace callback, if any.
+*/
+#define BK_TRACE_EXIT(name, key_type, index, length, rc)                                 \
+    do {                                                                                 \
+        BK_TRACE_USDT_EXIT(name, key_type, index, length, rc);                           \
+        if (__builtin_expect(__atomic_load_n(&bk_trace_installed, __ATOMIC_RELAXED), 0)) \
+        {                                                                                \
+            bk_trace_dispatch(#name, BK_TRACE_EXIT_POINT,                                \
+                              (key_type), (index), (length), (rc));                      \
+        }                                                                                \
+    } while (0)
+#else
+#define BK_TRACE_ENTRY(name, key_type, index, length)       ((void)0)
+#define BK_TRACE_EXIT(name, key_type, index, length, rc)    ((void)0)
+#endif
+
+
+/****************************************************************************
+*                      P U B L I C  I N T E R F A C E                       *
+*****************************************************************************/
+/*! \brief Call the installed trace callback. Used by \ref BK_TRACE_ENTRY and \ref BK_TRACE_EXIT.
+
+    \param[in] *name Probe name without _entry/_exit.
+
+    \param[in] point Entry or exit.
+
+    \param[in] key_type, index, length See the arguments of the USDT probes.
+
+    \param[in] rc Return code, \ref IID_SUCCESS on entry.
+*/
+void bk_trace_dispatch(const char             * const name,
+                       const bk_trace_point_t         point,
+                       const uint32_t                 key_type,
+                       const uint32_t                 index,
+                       const uint32_t                 length,
+                       const iid_return_t             rc);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __IID_BROADKEY_TRACE_PRIVATE__H__ */
@@ -54,6 +54,17 @@ extern "C"
 */
 #define IID_INVALID_PARAMETERS           (IID_RETURN_BASE + 0x01)
 
+/*! \brief System resources not available
+    \details Value indicating that a system resource needed by the function call (memory,
+             thread, file descriptor) could not be obtained.
+*/
+#define IID_ERROR_RESOURCES              (IID_RETURN_BASE + 0x02)
+
+/*! \brief Item not found
+    \details Value indicating that the item looked up by the function call does not exist.
+*/
+#define IID_NOT_FOUND                    (IID_RETURN_BASE + 0x03)
+
 
 /************************** Broadkey Specific Return Codes **************************/
 /*! \brief Error startup data